@@ -0,0 +1,121 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+#include <atomic>
+#include <openssl/crypto.h>
+#include "arena.h"
+
+namespace {
+    const size_t huge_page_size = size_t(2) << 20;
+
+    std::atomic<bool> use_huge_pages(true);
+
+    size_t round_up(size_t n, size_t to)
+    {
+        return (n + to - 1) / to * to;
+    }
+}
+
+scratch_arena_t::~scratch_arena_t()
+{
+    if (_base)
+        unmap(_base, _capacity);
+}
+
+scratch_arena_t& scratch_arena_t::thread_arena()
+{
+    static thread_local scratch_arena_t arena;
+    return arena;
+}
+
+void scratch_arena_t::set_huge_pages(bool on)
+{
+    use_huge_pages = on;
+}
+
+uint8_t* scratch_arena_t::map(size_t bytes)
+{
+#if defined(MADV_HUGEPAGE)
+    if (use_huge_pages && bytes >= huge_page_size)
+    {
+        // Populating before madvise would fault in small pages, so
+        // advise first and then touch every page.
+        void* p = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return 0;
+        madvise(p, bytes, MADV_HUGEPAGE);
+        memset(p, 0, bytes);
+        return static_cast<uint8_t*>(p);
+    }
+#endif
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_POPULATE)
+    flags |= MAP_POPULATE;
+#endif
+    void* p = mmap(0, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (p == MAP_FAILED)
+        return 0;
+    return static_cast<uint8_t*>(p);
+}
+
+void scratch_arena_t::unmap(uint8_t* base, size_t bytes)
+{
+    munmap(base, bytes);
+}
+
+bool scratch_arena_t::reserve(size_t bytes)
+{
+    if (bytes <= _capacity)
+        return true;
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t capacity = round_up(bytes, page);
+    if (capacity >= huge_page_size)
+        capacity = round_up(capacity, huge_page_size);
+    uint8_t* base = map(capacity);
+    if (base == 0)
+        return false;
+    if (_base)
+        unmap(_base, _capacity);
+    _base = base;
+    _capacity = capacity;
+    return true;
+}
+
+scratch_t::scratch_t(size_t bytes) : _arena(0), _mapping(0), _data(0), _size(bytes)
+{
+    scratch_arena_t& arena = scratch_arena_t::thread_arena();
+    if (!arena._in_use && bytes <= scratch_arena_t::_max_retained && arena.reserve(bytes))
+    {
+        arena._in_use = true;
+        _arena = &arena;
+        _data = arena._base;
+        return;
+    }
+    _mapping = scratch_arena_t::map(bytes);
+    if (_mapping)
+    {
+        _data = _mapping;
+        return;
+    }
+    _heap.resize(bytes);
+    _data = _heap.data();
+}
+
+scratch_t::~scratch_t()
+{
+    OPENSSL_cleanse(_data, _size);
+    if (_arena)
+        _arena->_in_use = false;
+    if (_mapping)
+        scratch_arena_t::unmap(_mapping, _size);
+}
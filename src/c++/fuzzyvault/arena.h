@@ -0,0 +1,96 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// A block of memory owned by one thread and reused for the large
+/// scratch buffers of the slow hash. It is mapped with mmap and faulted
+/// in up front, so once it has grown to the size of a call, later calls
+/// do not allocate or page fault. Where the kernel supports it the
+/// mapping is offered to transparent huge pages with madvise.
+///
+/// Use it through scratch_t. An arena is not thread safe.
+struct scratch_arena_t {
+    uint8_t* _base;         ///< the mapping, null if none
+    size_t _capacity;       ///< bytes mapped
+    bool _in_use;           ///< true while a scratch_t holds the arena
+
+    /// Arenas keep at most this many bytes between calls. Larger
+    /// requests get a mapping of their own that is released after use.
+    static const size_t _max_retained = size_t(64) << 20;
+
+    scratch_arena_t() : _base(0), _capacity(0), _in_use(false) {}
+
+    /// unmaps the memory
+    ~scratch_arena_t();
+
+    /// Returns the arena of the calling thread
+    static scratch_arena_t& thread_arena();
+
+    /// Turns the use of transparent huge pages on or off for mappings
+    /// made from now on. They are on by default.
+    /// @param on true to use huge pages
+    /// @returns void
+    static void set_huge_pages(bool on);
+
+    /// Maps bytes of pre-faulted memory
+    /// @param bytes the size of the mapping
+    /// @returns the mapping or null if mmap failed
+    static uint8_t* map(size_t bytes);
+
+    /// Releases a mapping made with map()
+    /// @returns void
+    static void unmap(uint8_t* base, size_t bytes);
+
+    /// Makes sure the arena holds at least bytes
+    /// @returns false if the memory could not be mapped
+    bool reserve(size_t bytes);
+
+private:
+    scratch_arena_t(const scratch_arena_t&);
+    scratch_arena_t& operator=(const scratch_arena_t&);
+};
+
+/// Scratch memory for one scope. It comes from the arena of the calling
+/// thread if the arena is free and large requests are within
+/// scratch_arena_t::_max_retained, from a mapping of its own otherwise,
+/// and from the heap if mmap fails. The memory is wiped when the scope
+/// ends.
+///
+///     scratch_t scratch(v_bytes);
+///     uint32_t* V = reinterpret_cast<uint32_t*>(scratch.data());
+struct scratch_t {
+    scratch_arena_t* _arena;        ///< the arena lent, or null
+    uint8_t* _mapping;              ///< a mapping of our own, or null
+    std::vector<uint8_t> _heap;     ///< used if mmap failed
+    uint8_t* _data;                 ///< the memory
+    size_t _size;                   ///< bytes requested
+
+    /// borrows bytes of scratch memory
+    /// @param bytes the number of bytes needed
+    scratch_t(size_t bytes);
+
+    /// wipes the memory and gives it back
+    ~scratch_t();
+
+    /// Returns the memory, aligned to a page unless it came from the heap
+    uint8_t* data() { return _data; }
+
+private:
+    scratch_t(const scratch_t&);
+    scratch_t& operator=(const scratch_t&);
+};
+
+#endif
@@ -0,0 +1,504 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <stdint.h>
+#include "imod.h"
+#include "poly.h"
+#include "secret.h"
+#include "batchdecode.h"
+#include "exceptions.h"
+#include "fuzzy.h"
+
+namespace {
+    const int L = batch_decoder_t::_lanes;
+
+    /// Modular reduction that the compiler can vectorize. There is no
+    /// SIMD integer division so x % p inside a loop over the lanes is
+    /// replaced by a Barrett reduction: the quotient estimate
+    /// (v * mu) >> shift is exact or one too small for all v < 2^31.
+    struct lane_mod_t {
+        uint32_t _p;
+        uint32_t _shift;
+        uint64_t _mu;
+
+        lane_mod_t(int p) : _p(p)
+        {
+            int bits = 0;
+            while ((1 << (bits + 1)) <= p)
+                bits++;
+            _shift = 32 + bits;
+            _mu = (uint64_t(1) << _shift) / _p;
+        }
+
+        /// v mod p for 0 <= v < 2^31
+        uint32_t reduce(uint32_t v) const
+        {
+            const uint32_t q = (uint32_t)((v * _mu) >> _shift);
+            const uint32_t r = v - q * _p;
+            return r >= _p ? r - _p : r;
+        }
+
+        /// (a - f * b) mod p for reduced values
+        uint32_t mul_sub(uint32_t a, uint32_t f, uint32_t b) const
+        {
+            return reduce(a + _p * _p - f * b);
+        }
+
+        /// (a * x + c) mod p for reduced values
+        uint32_t mul_add(uint32_t a, uint32_t x, uint32_t c) const
+        {
+            return reduce(a * x + c);
+        }
+    };
+}
+
+batch_decoder_t::batch_decoder_t(int setSize,
+                                 int errorThreshold
+                                 ) : _setSize(setSize),
+                                     _errorThreshold(errorThreshold),
+                                     _fallbacks(0),
+                                     _ws(setSize)
+{
+    if (setSize <= 0 || setSize > bw_max_set_size)
+        throw Exception("batch_decoder_t -- setSize out of range");
+    if (errorThreshold <= 0 || errorThreshold % 2 != 0 || errorThreshold >= setSize)
+        throw Exception("batch_decoder_t -- bad errorThreshold");
+    _system.resize(setSize * (setSize + 1) * L);
+}
+
+int batch_decoder_t::decode_scalar(const std::vector<int>& words,
+                                   const std::vector<int>& sketch,
+                                   std::vector<int>& out
+                                   )
+{
+    _fallbacks += 1;
+    try
+    {
+        secret_t::recover_words(words, sketch, _errorThreshold, out, _ws);
+        return decode_ok;
+    }
+    catch (const fuzzy_vault::NoSolutionException&)
+    {
+        out.clear();
+        return decode_no_solution;
+    }
+    catch (const Exception&)
+    {
+        out.clear();
+        return decode_error;
+    }
+}
+
+void batch_decoder_t::decode(const std::vector<std::vector<int>>& words,
+                             const std::vector<std::vector<int>>& sketches,
+                             std::vector<std::vector<int>>& out,
+                             std::vector<int>& status
+                             )
+{
+    if (words.size() != sketches.size())
+        throw Exception("batch_decoder_t::decode -- |words| != |sketches|");
+    const size_t count = words.size();
+    out.resize(count);
+    status.assign(count, decode_error);
+
+    const std::vector<int>* group_words[L];
+    const std::vector<int>* group_sketches[L];
+    std::vector<int>* group_out[L];
+    size_t group_index[L];
+    int group_status[L];
+    int n = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        // inputs that do not fit the profile get the scalar treatment
+        // so that they fail (or not) exactly as recover_words() does
+        if (words[i].size() != static_cast<size_t>(_setSize) ||
+            sketches[i].size() != static_cast<size_t>(_errorThreshold))
+        {
+            status[i] = decode_scalar(words[i], sketches[i], out[i]);
+            continue;
+        }
+        group_words[n] = &words[i];
+        group_sketches[n] = &sketches[i];
+        group_out[n] = &out[i];
+        group_index[n] = i;
+        n++;
+        if (n == L)
+        {
+            decode_group(group_words, group_sketches, group_out, group_status, n);
+            for (int j = 0; j < n; j++)
+                status[group_index[j]] = group_status[j];
+            n = 0;
+        }
+    }
+    if (n > 0)
+    {
+        decode_group(group_words, group_sketches, group_out, group_status, n);
+        for (int j = 0; j < n; j++)
+            status[group_index[j]] = group_status[j];
+    }
+}
+
+void batch_decoder_t::decode_group(const std::vector<int>* const* words,
+                                   const std::vector<int>* const* sketches,
+                                   std::vector<int>** out,
+                                   int* status,
+                                   int count
+                                   )
+{
+    const int p = imod_t::_modulus;
+    const int* inverses = imod_t::_inverses;
+    if (p <= 0 || inverses == 0)
+        throw Exception("batch_decoder_t -- modulus is not initialized");
+    const lane_mod_t mod(p);
+
+    // the system solved is the one built by
+    // berlekamp_welch(words, bs, n - T, T / 2)
+    const int n = _setSize;
+    const int T = _errorThreshold;
+    const int k = n - T;
+    const int t = T / 2;
+    const int R = n;
+    const int C = n + 1;
+    const int last = n;
+    int* system = _system.data();
+    auto at = [system, C](int row, int col) { return system + (row * C + col) * L; };
+
+    // per lane state. Lanes past count repeat lane 0 and are ignored.
+    bool active[L];     // still decoding in lockstep
+    bool scalar[L];     // must be decoded by the scalar code
+    for (int l = 0; l < L; l++)
+    {
+        active[l] = l < count;
+        scalar[l] = false;
+        status[l] = decode_ok;
+    }
+
+    // p_high, lane interleaved. A sketch value that is not a legal
+    // modular value makes get_phigh() throw so those lanes go scalar.
+    uint32_t phigh[poly_t::_coeff_count * L];
+    for (int l = 0; l < L; l++)
+    {
+        const std::vector<int>& sketch = *sketches[l < count ? l : 0];
+        for (int j = 0; j < k; j++)
+            phigh[j * L + l] = 0;
+        for (int j = 0; j < T; j++)
+        {
+            if (!(0 <= sketch[j] && sketch[j] < p))
+                scalar[l] = true;
+            phigh[(j + k) * L + l] = scalar[l] ? 0 : sketch[j];
+        }
+        phigh[n * L + l] = 1;
+    }
+
+    // build the augmented systems one row at a time
+    for (int i = 0; i < R; i++)
+    {
+        uint32_t a[L];
+        uint32_t b[L];
+        uint32_t power[L];
+        for (int l = 0; l < L; l++)
+        {
+            const int w = (*words[l < count ? l : 0])[i] % p;
+            a[l] = w < 0 ? w + p : w;
+            b[l] = 0;
+            power[l] = 1;
+        }
+        for (int j = n; j >= 0; j--)
+        {
+            for (int l = 0; l < L; l++)
+                b[l] = mod.mul_add(b[l], a[l], phigh[j * L + l]);
+        }
+        for (int j = 0; j < k + t; j++)
+        {
+            int* m = at(i, j);
+            for (int l = 0; l < L; l++)
+                m[l] = power[l];
+            if (j < t)
+            {
+                int* m_e = at(i, j + k + t);
+                for (int l = 0; l < L; l++)
+                    m_e[l] = mod.mul_sub(0, b[l], power[l]);
+            }
+            if (j == t)
+            {
+                int* m_y = at(i, last);
+                for (int l = 0; l < L; l++)
+                    m_y[l] = mod.reduce(b[l] * power[l]);
+            }
+            for (int l = 0; l < L; l++)
+                power[l] = mod.reduce(power[l] * a[l]);
+        }
+    }
+
+    // Gaussian elimination. Every lane keeps its own pivot row h[l] so
+    // row swaps and columns without a pivot do not break the lockstep.
+    // The scaled pivot row of each lane is copied to pivot[] and rows
+    // of lanes that do not take part get a zero factor.
+    int h[L];
+    int pivot_row[L];
+    uint32_t pivot[(bw_max_set_size + 1) * L];
+    for (int l = 0; l < L; l++)
+        h[l] = 0;
+    for (int col = 0; col < C; col++)
+    {
+        int lo = R;
+        for (int l = 0; l < L; l++)
+        {
+            pivot_row[l] = R;
+            for (int j = col; j < C; j++)
+                pivot[j * L + l] = 0;
+            if (h[l] >= R)
+                continue;
+            int pr = -1;
+            for (int i = h[l]; i < R; i++)
+            {
+                if (at(i, col)[l] != 0)
+                {
+                    pr = i;
+                    break;
+                }
+            }
+            if (pr < 0)
+                continue;
+            if (pr != h[l])
+            {
+                for (int j = 0; j < C; j++)
+                {
+                    const int v = at(pr, j)[l];
+                    at(pr, j)[l] = at(h[l], j)[l];
+                    at(h[l], j)[l] = v;
+                }
+            }
+            const uint32_t scale = inverses[at(h[l], col)[l]];
+            for (int j = col; j < C; j++)
+            {
+                const uint32_t v = mod.reduce(scale * at(h[l], j)[l]);
+                at(h[l], j)[l] = v;
+                pivot[j * L + l] = v;
+            }
+            pivot_row[l] = h[l];
+            if (h[l] < lo)
+                lo = h[l];
+            h[l]++;
+        }
+        for (int i = lo + 1; i < R; i++)
+        {
+            uint32_t f[L];
+            const int* m_col = at(i, col);
+            for (int l = 0; l < L; l++)
+                f[l] = i > pivot_row[l] ? m_col[l] : 0;
+            for (int j = col; j < C; j++)
+            {
+                int* m = at(i, j);
+                const uint32_t* v = pivot + j * L;
+                for (int l = 0; l < L; l++)
+                    m[l] = mod.mul_sub(m[l], f[l], v[l]);
+            }
+        }
+    }
+
+    // Lanes with a zero on the diagonal are singular. A singular lane
+    // without all zero rows at the bottom is inconsistent.
+    bool singular[L];
+    int null_count[L];
+    for (int l = 0; l < L; l++)
+    {
+        singular[l] = false;
+        for (int r = 0; r < R; r++)
+        {
+            if (at(r, r)[l] == 0)
+                singular[l] = true;
+        }
+        null_count[l] = 0;
+        if (!singular[l])
+            continue;
+        for (int r = R - 1; r >= 0; r--)
+        {
+            bool is_null = true;
+            for (int j = 0; j < C; j++)
+            {
+                if (at(r, j)[l] != 0)
+                    is_null = false;
+            }
+            if (!is_null)
+                break;
+            null_count[l]++;
+        }
+        if (null_count[l] == 0 && active[l] && !scalar[l])
+        {
+            status[l] = decode_no_solution;
+            active[l] = false;
+        }
+    }
+
+    // back substitution of the non-singular lanes, see
+    // matrix_view_t::back_substitute(). Only the right hand side
+    // column is needed so the eliminated values are not cleared.
+    for (int r = R - 1; r > 0; r--)
+    {
+        uint32_t b[L];
+        const int* m_y = at(r, last);
+        for (int l = 0; l < L; l++)
+            b[l] = singular[l] ? 0 : m_y[l];
+        for (int r1 = r - 1; r1 >= 0; r1--)
+        {
+            int* y = at(r1, last);
+            const int* m = at(r1, r);
+            for (int l = 0; l < L; l++)
+                y[l] = mod.mul_sub(y[l], m[l], b[l]);
+        }
+    }
+    uint32_t x[bw_max_set_size * L];
+    for (int r = 0; r < R; r++)
+    {
+        for (int l = 0; l < L; l++)
+            x[r * L + l] = singular[l] ? 0 : at(r, last)[l];
+    }
+
+    // particular solution of the singular lanes, see
+    // matrix_view_t::solve_solvable_singular()
+    for (int r = R - 1; r >= 0; r--)
+    {
+        int lead[L];
+        int lo = C;
+        for (int l = 0; l < L; l++)
+        {
+            lead[l] = -1;
+            if (!singular[l] || !active[l] || r >= R - null_count[l])
+                continue;
+            int c = 0;
+            while (c < C && at(r, c)[l] != 1)
+                c++;
+            if (c >= last)
+            {
+                if (!scalar[l])
+                    status[l] = decode_no_solution;
+                active[l] = false;
+                continue;
+            }
+            lead[l] = c;
+            x[c * L + l] = at(r, last)[l];
+            if (c < lo)
+                lo = c;
+        }
+        if (lo == C)
+            continue;
+        for (int r1 = r - 1; r1 >= 0; r1--)
+        {
+            uint32_t f[L];
+            for (int l = 0; l < L; l++)
+                f[l] = lead[l] < 0 ? 0 : at(r1, lead[l])[l];
+            for (int j = lo; j < C; j++)
+            {
+                int* m = at(r1, j);
+                const int* v = at(r, j);
+                for (int l = 0; l < L; l++)
+                    m[l] = mod.mul_sub(m[l], f[l], v[l]);
+            }
+        }
+    }
+
+    // Q has coefficients x[0 .. k + t) and E is monic with coefficients
+    // x[k + t .. n). poly_t::div_rem() throws when deg Q < deg E so those
+    // lanes go scalar. Otherwise dividing by the monic E in lockstep
+    // gives the same quotient and remainder as div_rem().
+    for (int l = 0; l < L; l++)
+    {
+        bool low_degree = true;
+        for (int j = t; j < k + t; j++)
+        {
+            if (x[j * L + l] != 0)
+                low_degree = false;
+        }
+        if (low_degree && active[l])
+            scalar[l] = true;
+    }
+    uint32_t* u = x;
+    const uint32_t* e = x + (k + t) * L;
+    uint32_t q[poly_t::_coeff_count * L];
+    for (int j = 0; j < poly_t::_coeff_count * L; j++)
+        q[j] = 0;
+    for (int kk = k - 1; kk >= 0; kk--)
+    {
+        uint32_t* qk = q + kk * L;
+        for (int l = 0; l < L; l++)
+            qk[l] = u[(t + kk) * L + l];
+        for (int j = t + kk - 1; j >= kk; j--)
+        {
+            uint32_t* uj = u + j * L;
+            const uint32_t* v = e + (j - kk) * L;
+            for (int l = 0; l < L; l++)
+                uj[l] = mod.mul_sub(uj[l], qk[l], v[l]);
+        }
+    }
+    for (int l = 0; l < L; l++)
+    {
+        for (int j = 0; j < t; j++)
+        {
+            if (u[j * L + l] != 0 && active[l] && !scalar[l])
+            {
+                status[l] = decode_no_solution;
+                active[l] = false;
+            }
+        }
+    }
+
+    // p_diff = p_high - p_low, then every field element is tested as a
+    // root of every lane at once. A polynomial of degree n has at most
+    // n roots so the search stops once every lane has found n.
+    uint32_t diff[poly_t::_coeff_count * L];
+    for (int j = 0; j <= n; j++)
+    {
+        for (int l = 0; l < L; l++)
+            diff[j * L + l] = mod.mul_sub(phigh[j * L + l], 1, q[j * L + l]);
+    }
+    int root_count[L];
+    int pending = 0;
+    for (int l = 0; l < L; l++)
+    {
+        root_count[l] = 0;
+        if (active[l] && !scalar[l])
+        {
+            out[l]->resize(n);
+            pending++;
+        }
+    }
+    for (int xv = 0; xv < p && pending > 0; xv++)
+    {
+        uint32_t acc[L];
+        for (int l = 0; l < L; l++)
+            acc[l] = diff[n * L + l];
+        for (int j = n - 1; j >= 0; j--)
+        {
+            const uint32_t* d = diff + j * L;
+            for (int l = 0; l < L; l++)
+                acc[l] = mod.mul_add(acc[l], xv, d[l]);
+        }
+        for (int l = 0; l < L; l++)
+        {
+            if (acc[l] != 0 || !active[l] || scalar[l] || root_count[l] == n)
+                continue;
+            (*out[l])[root_count[l]] = xv;
+            root_count[l]++;
+            if (root_count[l] == n)
+                pending--;
+        }
+    }
+
+    for (int l = 0; l < count; l++)
+    {
+        if (scalar[l])
+            status[l] = decode_scalar(*words[l], *sketches[l], *out[l]);
+        else if (active[l] && root_count[l] != n)
+            status[l] = decode_no_solution;
+        if (status[l] != decode_ok)
+            out[l]->clear();
+    }
+}
@@ -0,0 +1,92 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _BATCHDECODE_H_
+#define _BATCHDECODE_H_
+
+#include <vector>
+#include "workspace.h"
+
+/// The outcome of decoding one vault in a batch
+enum decode_status_e {
+    decode_ok = 0,          ///< the words were recovered
+    decode_no_solution,     ///< too many errors, recover_words would throw NoSolutionException
+    decode_error            ///< bad input, recover_words would throw Exception
+};
+
+/// Decodes many vaults that share one (setSize, errorThreshold, prime)
+/// profile. The vaults are processed in groups of _lanes. Within a group
+/// the Berlekamp-Welch systems, the division Q / E and the root search
+/// are stored in structure-of-arrays form, one vault per lane, so every
+/// inner loop runs over the lanes with the same instruction stream and
+/// the compiler can map it to SIMD registers.
+///
+/// Row swaps, columns without a pivot and singular (but consistent)
+/// systems are handled per lane with masks so the lanes stay in lockstep.
+/// A lane whose Q has a lower degree than expected is decoded by the
+/// scalar secret_t::recover_words() instead. Every lane produces exactly
+/// what recover_words() produces for the same input.
+///
+/// As with secret_t the modulus must have been set with imod_t::initialize()
+/// to the prime of the profile before decode() is called.
+struct batch_decoder_t {
+    static const int _lanes = 8;    ///< vaults decoded in lockstep
+
+    int _setSize;                   ///< number of words in every vault
+    int _errorThreshold;            ///< symmetric error threshold (2 * (setSize - correctThreshold))
+    int _fallbacks;                 ///< number of lanes decoded by the scalar code so far
+
+    std::vector<int> _system;       ///< lane interleaved augmented systems
+    decoder_workspace_t _ws;        ///< workspace of the scalar fallback
+
+    /// construct a decoder for a profile
+    /// @param setSize the number of words in every vault
+    /// @param errorThreshold 2 * (setSize - correctThreshold)
+    batch_decoder_t(int setSize,
+                    int errorThreshold
+                    );
+
+    /// Attempts to recover the original words of many vaults
+    /// @param words recovery words, one list of setSize words per vault
+    /// @param sketches the sketch of each vault
+    /// @param out destination for the recovered words of each vault.
+    ///     The entry of a vault that did not decode is cleared.
+    /// @param status destination for a decode_status_e per vault
+    /// @returns void
+    void decode(const std::vector<std::vector<int>>& words,
+                const std::vector<std::vector<int>>& sketches,
+                std::vector<std::vector<int>>& out,
+                std::vector<int>& status
+                );
+
+    /// Decodes up to _lanes vaults in lockstep. Inputs that do not
+    /// match the profile must have been filtered out by the caller.
+    /// @param words recovery words of each vault
+    /// @param sketches sketch of each vault
+    /// @param out destination for the recovered words of each vault
+    /// @param status destination for the status of each vault
+    /// @param count number of vaults, 1 .. _lanes
+    /// @returns void
+    void decode_group(const std::vector<int>* const* words,
+                      const std::vector<int>* const* sketches,
+                      std::vector<int>** out,
+                      int* status,
+                      int count
+                      );
+
+    /// Decodes one vault with secret_t::recover_words()
+    /// @returns the status of the vault
+    int decode_scalar(const std::vector<int>& words,
+                      const std::vector<int>& sketch,
+                      std::vector<int>& out
+                      );
+};
+
+#endif
@@ -26,36 +26,53 @@ poly_t berlekamp_welch(
 {
     if (as.size() != bs.size() || as.size() == 0)
         throw Exception("berlekamp_welch: |as| != |bs|");
+    bw_matrix_t m;
+    return berlekamp_welch(as.data(), bs.data(), (int)as.size(), k, t, m);
+}
+
+poly_t berlekamp_welch(
+    const int* as,
+    const int* bs,
+    const int n,
+    const int k,
+    const int t,
+    bw_matrix_t& m
+    )
+{
+    if (n <= 0 || n > bw_max_set_size)
+        throw Exception("berlekamp_welch: n out of range");
     if (k <= 0 || t <= 0)
         throw Exception("berlekamp_welch: k <= 0 || t <= 0");
-    const int n = (int)as.size();
-    matrix_t m(n, n);
-    matrix_t y(n, 1);
-    
+    if (k + 2 * t > n)
+        throw Exception("berlekamp_welch: k + 2 * t > n");
+
+    // the augmented system [M | y] is built in place
+    m.resize(n, n + 1);
+    imod_t apowers[poly_t::_coeff_count];
     for (int i = 0; i < n; i++)
     {
+        imod_t* row = m.row(i);
         const imod_t b = bs[i];
-        std::vector<imod_t>apowers(k + t);
-        imod_t::get_powers(as[i], apowers);
+        imod_t::get_powers(as[i], apowers, k + t);
         for (int j = 0; j < k + t; j++)
-            m.set(i, j, apowers[j]);
+            row[j] = apowers[j];
         for (int j = 0; j < t; j++)
-            m.set(i, j + k + t, - (b * apowers[j]));
-        y.set(i, 0, b * apowers[t]);
+            row[j + k + t] = - (b * apowers[j]);
+        row[n] = b * apowers[t];
     }
-    matrix_t x = m.solve(y);
+    imod_t x[bw_max_set_size];
+    if (!m.view().solve(x))
+        throw fuzzy_vault::NoSolutionException();
 
-    std::vector<imod_t> Qs(k + t);
+    poly_t Q;
     for (int i = 0; i < k + t; i++)
-        Qs[i] = x.get(i, 0);
-    poly_t Q(Qs);
+        Q._coeffs[i] = x[i];
 
     const int e = n - k - t;
-    std::vector<imod_t> Es(e + 1);
+    poly_t E;
     for (int i = 0; i < e; i++)
-        Es[i] = x.get(k + t + i, 0);
-    Es[e] = 1;
-    poly_t E(Es);
+        E._coeffs[i] = x[k + t + i];
+    E._coeffs[e] = 1;
 
     poly_t q;
     poly_t r;
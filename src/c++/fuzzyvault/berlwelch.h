@@ -13,6 +13,15 @@
 
 #include <vector>
 #include "poly.h"
+#include "matrix.h"
+
+/// The largest set size the decoder supports. The recovered polynomial
+/// has degree setSize so it must fit in a poly_t.
+const int bw_max_set_size = poly_t::_coeff_count - 1;
+
+/// The augmented Berlekamp-Welch system for the largest set size.
+/// It is about 4KB so it can live on the stack or in a workspace.
+typedef fixed_matrix_t<bw_max_set_size, bw_max_set_size + 1> bw_matrix_t;
 
 /// This is the Berlekamp-Welsch-Decoder as described in the whitepaper
 /// 
@@ -26,4 +35,22 @@ poly_t berlekamp_welch(const std::vector<int>& as,
                        int k,
                        int t
                        );
+
+/// The allocation free form of berlekamp_welch(). The augmented system
+/// is built and solved in place in the supplied matrix.
+///
+/// @param as n recovery words
+/// @param bs n values of p_high at the recovery words
+/// @param n the number of words, at most bw_max_set_size
+/// @param k an integer equal to setSize (len(as)) minus the errorThreshold (t)
+/// @param t errorTheshold (2 * (setSize - correctThreshold))
+/// @param m scratch space for the augmented system
+/// @return a polynomial p_low
+poly_t berlekamp_welch(const int* as,
+                       const int* bs,
+                       int n,
+                       int k,
+                       int t,
+                       bw_matrix_t& m
+                       );
 #endif
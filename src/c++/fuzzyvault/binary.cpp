@@ -0,0 +1,185 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include "binary.h"
+#include "fuzzy.h"
+#include "params.h"
+#include "secret.h"
+#include "exceptions.h"
+
+namespace {
+    const uint8_t magic[3] = { 'F', 'V', 'S' };
+    const uint8_t params_magic[3] = { 'F', 'V', 'P' };
+
+    uint16_t le16dec(const uint8_t* p)
+    {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint32_t le32dec(const uint8_t* p)
+    {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    /// Appends n in width bytes, throwing if it does not fit
+    void put(std::vector<uint8_t>& out, long long n, int width)
+    {
+        if (n < 0 || (static_cast<unsigned long long>(n) >> (8 * width)) != 0)
+            throw Exception("write_binary -- a field does not fit the binary format");
+        for (int i = 0; i < width; i++, n >>= 8)
+            out.push_back(static_cast<uint8_t>(n & 0xff));
+    }
+
+    /// Appends the header and the extractor, the fields parameters and
+    /// secrets share
+    template <typename T>
+    void put_header(std::vector<uint8_t>& out,
+                    const uint8_t* tag,
+                    const T& fields,
+                    const std::vector<int>& sketch,
+                    const std::vector<uint8_t>& hash
+                    )
+    {
+        if (fields._extractor.size() != static_cast<size_t>(fields._setSize))
+            throw Exception("write_binary -- the extractor does not have setSize elements");
+        const kdf_params_t& kdf = fields._kdf;
+        out.clear();
+        out.reserve(binary_header_size + 2 * (fields._extractor.size() + sketch.size()) +
+                    fields._salt.size() + hash.size());
+        out.insert(out.end(), tag, tag + 3);
+        put(out, binary_format_1, 1);
+        put(out, fields._version, 1);
+        put(out, kdf._algorithm, 1);
+        put(out, 0, 2);
+        put(out, fields._setSize, 2);
+        put(out, fields._correctThreshold, 2);
+        put(out, fields._corpusSize, 2);
+        put(out, fields._prime, 2);
+        put(out, sketch.size(), 2);
+        put(out, fields._salt.size(), 2);
+        put(out, hash.size(), 2);
+        put(out, kdf._length, 2);
+        put(out, kdf._scryptN, 4);
+        put(out, kdf._scryptR, 1);
+        put(out, kdf._argon2Lanes, 1);
+        put(out, kdf._scryptP, 2);
+        put(out, kdf._argon2Memory, 4);
+        put(out, kdf._argon2Iterations, 2);
+        put(out, 0, 2);
+        for (int x : fields._extractor)
+            put(out, x, 2);
+    }
+}
+
+void write_binary(const secret_t& secret, std::vector<uint8_t>& out)
+{
+    put_header(out, magic, secret, secret._sketch, secret._hash);
+    for (int x : secret._sketch)
+        put(out, x, 2);
+    out.insert(out.end(), secret._salt.begin(), secret._salt.end());
+    out.insert(out.end(), secret._hash.begin(), secret._hash.end());
+}
+
+void write_params_binary(const params_t& params, std::vector<uint8_t>& out)
+{
+    put_header(out, params_magic, params, std::vector<int>(), std::vector<uint8_t>());
+    out.insert(out.end(), params._salt.begin(), params._salt.end());
+}
+
+kdf_params_t read_binary_kdf(const fuzzy_vault::vault_secret_view_t& view)
+{
+    const uint8_t* p = view.data();
+    kdf_params_t kdf;
+    kdf._algorithm = p[5];
+    kdf._length = le16dec(p + 22);
+    kdf._scryptN = static_cast<int>(le32dec(p + 24));
+    kdf._scryptR = p[28];
+    kdf._argon2Lanes = p[29];
+    kdf._scryptP = le16dec(p + 30);
+    kdf._argon2Memory = static_cast<int>(le32dec(p + 32));
+    kdf._argon2Iterations = le16dec(p + 36);
+    return kdf;
+}
+
+fuzzy_vault::vault_secret_view_t::vault_secret_view_t(const uint8_t* data, size_t size)
+    : _data(data), _size(0)
+{
+    if (data == 0 || size < binary_header_size)
+        throw Exception("vault_secret_view_t -- too short for a secret");
+    if (data[0] != magic[0] || data[1] != magic[1] || data[2] != magic[2])
+        throw Exception("vault_secret_view_t -- not a binary secret");
+    if (data[3] != binary_format_1)
+        throw Exception("vault_secret_view_t -- unsupported format");
+    _size = binary_header_size + 2 * (static_cast<size_t>(setSize()) + sketchSize()) +
+            saltSize() + hashSize();
+    if (size < _size)
+        throw Exception("vault_secret_view_t -- truncated secret");
+}
+
+int fuzzy_vault::vault_secret_view_t::version() const
+{
+    return _data[4];
+}
+
+int fuzzy_vault::vault_secret_view_t::setSize() const
+{
+    return le16dec(_data + 8);
+}
+
+int fuzzy_vault::vault_secret_view_t::correctThreshold() const
+{
+    return le16dec(_data + 10);
+}
+
+int fuzzy_vault::vault_secret_view_t::corpusSize() const
+{
+    return le16dec(_data + 12);
+}
+
+int fuzzy_vault::vault_secret_view_t::prime() const
+{
+    return le16dec(_data + 14);
+}
+
+int fuzzy_vault::vault_secret_view_t::sketchSize() const
+{
+    return le16dec(_data + 16);
+}
+
+size_t fuzzy_vault::vault_secret_view_t::saltSize() const
+{
+    return le16dec(_data + 18);
+}
+
+size_t fuzzy_vault::vault_secret_view_t::hashSize() const
+{
+    return le16dec(_data + 20);
+}
+
+int fuzzy_vault::vault_secret_view_t::extractor(int i) const
+{
+    return le16dec(_data + binary_header_size + 2 * i);
+}
+
+int fuzzy_vault::vault_secret_view_t::sketch(int i) const
+{
+    return le16dec(_data + binary_header_size + 2 * (setSize() + i));
+}
+
+const uint8_t* fuzzy_vault::vault_secret_view_t::salt() const
+{
+    return _data + binary_header_size + 2 * (setSize() + sketchSize());
+}
+
+const uint8_t* fuzzy_vault::vault_secret_view_t::hash() const
+{
+    return salt() + saltSize();
+}
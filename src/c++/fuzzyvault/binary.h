@@ -0,0 +1,82 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _BINARY_H_
+#define _BINARY_H_
+
+#include <stdint.h>
+#include <vector>
+#include "kdf.h"
+
+struct params_t;
+struct secret_t;
+
+namespace fuzzy_vault {
+    class vault_secret_view_t;
+}
+
+/// The binary format of a secret, all integers little endian
+///
+///     offset  bytes
+///          0      4  "FVS" and the format version, binary_format_1
+///          4      1  the version of the secret, see vault_version_1
+///          5      1  the slow hash, kdf_scrypt or kdf_argon2id
+///          6      2  zero
+///          8      2  setSize
+///         10      2  correctThreshold
+///         12      2  corpusSize
+///         14      2  prime
+///         16      2  elements of the sketch
+///         18      2  bytes of the salt
+///         20      2  bytes of the hash
+///         22      2  kdfLength
+///         24      4  scryptN
+///         28      1  scryptR
+///         29      1  argon2Lanes
+///         30      2  scryptP
+///         32      4  argon2Memory
+///         36      2  argon2Iterations
+///         38      2  zero
+///         40         the extractor and the sketch, two bytes an element,
+///                    then the salt and the hash
+///
+/// Every field element is below the prime, which is at most 0x8000, so
+/// two bytes hold it. The header carries every field of the JSON form
+/// so the two convert into each other without loss.
+///
+/// Parameters alone are written in the same layout, tagged "FVP" and
+/// with no sketch and no hash. That form is canonical, one encoding for
+/// equal parameters however their JSON is spaced or ordered, and is what
+/// params_id() hashes.
+const int binary_format_1 = 1;
+
+/// bytes before the extractor
+const size_t binary_header_size = 40;
+
+/// Writes a secret in the binary format. Throws an Exception if a
+/// field does not fit its width.
+/// @param secret the secret
+/// @param out destination of the encoding, replaced
+/// @returns void
+void write_binary(const secret_t& secret, std::vector<uint8_t>& out);
+
+/// Writes parameters in the binary format, see above. Throws an
+/// Exception if a field does not fit its width.
+/// @param params the parameters
+/// @param out destination of the encoding, replaced
+/// @returns void
+void write_params_binary(const params_t& params, std::vector<uint8_t>& out);
+
+/// Reads the slow hash parameters from the header of a secret
+/// @param view a checked view of the secret
+/// @returns the parameters
+kdf_params_t read_binary_kdf(const fuzzy_vault::vault_secret_view_t& view);
+
+#endif
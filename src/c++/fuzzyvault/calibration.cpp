@@ -0,0 +1,148 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "calibration.h"
+#include "crypto.h"
+#include "params.h"
+#include "pool.h"
+
+namespace {
+    typedef std::chrono::steady_clock clock_type;
+
+    /// the most memory one guess may take, the V budget of scrypt_native()
+    const size_t max_memory = size_t(1) << 30;
+
+    /// each cost is the best of this many runs
+    const int runs = 2;
+
+    double elapsed_ms(clock_type::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+    }
+
+    /// A password of the size secret_t::get_scrypt() hashes
+    std::vector<uint8_t> sample_pass(int setSize)
+    {
+        const std::string prefix = "original_words:";
+        std::vector<uint8_t> pass(prefix.begin(), prefix.end());
+        for (int i = 0; i < setSize; i++)
+            pushback_int(i, pass);
+        return pass;
+    }
+
+    /// Times the slow hashes of one gen_keys(), see calibrate_kdf()
+    double time_gen_keys(const kdf_params_t& kdf, int version, int setSize)
+    {
+        const std::vector<uint8_t> pass = sample_pass(setSize);
+        const std::vector<uint8_t> salt(params_salt_size, 0x5a);
+        double best = 0;
+        for (int run = 0; run < runs; run++)
+        {
+            std::vector<uint8_t> hash;
+            std::vector<uint8_t> ek;
+            const clock_type::time_point start = clock_type::now();
+            if (version == vault_version_2)
+                crypto::slow_hash(pass, salt, hash, 2 * kdf._length, kdf);
+            else
+            {
+                task_group_t group;
+                group.run([&]() { crypto::slow_hash(pass, salt, hash, kdf._length, kdf); });
+                crypto::slow_hash(pass, salt, ek, kdf._length, kdf);
+                group.wait();
+            }
+            const double ms = elapsed_ms(start);
+            best = run == 0 ? ms : std::min(best, ms);
+        }
+        return best;
+    }
+
+    /// Times the verification hash, the work of testing one guess
+    double time_guess(const kdf_params_t& kdf, int version, int setSize)
+    {
+        const std::vector<uint8_t> pass = sample_pass(setSize);
+        const std::vector<uint8_t> salt(params_salt_size, 0x5a);
+        const size_t length = version == vault_version_2 ? 2 * kdf._length : kdf._length;
+        double best = 0;
+        for (int run = 0; run < runs; run++)
+        {
+            std::vector<uint8_t> hash;
+            const clock_type::time_point start = clock_type::now();
+            crypto::slow_hash(pass, salt, hash, length, kdf);
+            const double ms = elapsed_ms(start);
+            best = run == 0 ? ms : std::min(best, ms);
+        }
+        return best;
+    }
+
+    bool within_limits(const kdf_params_t& kdf)
+    {
+        try
+        {
+            kdf.check();
+        }
+        catch(const std::exception& e)
+        {
+            return false;
+        }
+        return kdf.memory() <= max_memory;
+    }
+}
+
+kdf_calibration_t calibrate_kdf(const kdf_params_t& start,
+                                int version,
+                                int setSize,
+                                double budget_ms
+                                )
+{
+    const bool argon2 = start._algorithm == kdf_argon2id;
+    int kdf_params_t::* const memory = argon2 ? &kdf_params_t::_argon2Memory : &kdf_params_t::_scryptN;
+    int kdf_params_t::* const rounds = argon2 ? &kdf_params_t::_argon2Iterations : &kdf_params_t::_scryptP;
+
+    // the cheapest parameters, with one scrypt lane per thread so the
+    // lanes all run at the same time
+    kdf_calibration_t result;
+    result._kdf = start;
+    if (argon2)
+    {
+        result._kdf._argon2Memory = 8 * start._argon2Lanes;
+        result._kdf._argon2Iterations = 1;
+    }
+    else
+    {
+        result._kdf._scryptN = 16;
+        result._kdf._scryptP = std::min(thread_pool_t::current().thread_count() + 1, 1024);
+    }
+    result._kdf.check();
+    result._genKeysMs = time_gen_keys(result._kdf, version, setSize);
+    result._fits = result._genKeysMs <= budget_ms;
+
+    int kdf_params_t::* const fields[] = { memory, rounds };
+    for (int f = 0; f < 2 && result._fits; f++)
+    {
+        while (true)
+        {
+            kdf_params_t next = result._kdf;
+            next.*fields[f] *= 2;
+            if (!within_limits(next))
+                break;
+            const double ms = time_gen_keys(next, version, setSize);
+            if (ms > budget_ms)
+                break;
+            result._kdf = next;
+            result._genKeysMs = ms;
+        }
+    }
+    result._guessMs = time_guess(result._kdf, version, setSize);
+    return result;
+}
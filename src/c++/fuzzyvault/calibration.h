@@ -0,0 +1,50 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _CALIBRATION_H_
+#define _CALIBRATION_H_
+
+#include "kdf.h"
+
+/// The outcome of calibrate_kdf()
+struct kdf_calibration_t {
+    kdf_params_t _kdf;      ///< the parameters chosen
+    double _guessMs;        ///< wall time of one verification hash
+    double _genKeysMs;      ///< wall time of the slow hashes of one gen_keys()
+    bool _fits;             ///< false if even the cheapest parameters exceed the budget
+};
+
+/// Chooses the cost of the slow hash so the slow hashes of one gen_keys()
+/// take at most budget_ms on this host with the current thread pool.
+///
+/// The slow hashes are the whole cost of gen_keys() that grows with the
+/// parameters, so they are what is timed: two calls at the same time for
+/// version 1 secrets and one call of twice the length for version 2,
+/// exactly as secret_t::get_hash_and_ek() runs them. The memory is raised
+/// first, then the rounds over it, doubling each while the measured time
+/// still fits.
+///
+/// For scrypt the memory is N and the rounds are the lanes p, which start
+/// at one per thread, r is kept. For Argon2id they are argon2Memory and
+/// argon2Iterations, argon2Lanes is kept. The other fields of start are
+/// kept as well.
+///
+/// @param start the algorithm and the fields that are not searched
+/// @param version the version of the secrets, see vault_version_1
+/// @param setSize the number of words, which sets the size of the password
+/// @param budget_ms the time allowed
+/// @returns the parameters and their measured cost
+kdf_calibration_t calibrate_kdf(const kdf_params_t& start,
+                                int version,
+                                int setSize,
+                                double budget_ms
+                                );
+
+#endif
@@ -11,46 +11,78 @@
 #include <openssl/ssl.h>
 #include <openssl/rand.h>
 #include <openssl/kdf.h>
+#include <openssl/core_names.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+#include <openssl/thread.h>
+#endif
 #include <memory.h>
 #include <iostream>
 #include <algorithm>
 #include <functional>
 #include <random>
 #include <limits.h>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <pthread.h>
 #include "crypto.h"
+#include "scrypt.h"
+#include "keccak.h"
+#include "provider.h"
+#include "pool.h"
 #include "exceptions.h"
 
-namespace crypto {
+namespace {
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+    /// guards argon2_booked
+    std::mutex argon2_mutex;
+    /// OpenSSL threads held by Argon2 derivations running now
+    uint64_t argon2_booked = 0;
+#endif
 
-    int first_prime_greater_than(int k)
-    {
-        if (k < 1)
-            throw Exception("first_prime_greater_than -- k < 1");
-        while (true)
+    /// The OpenSSL threads of one Argon2 derivation. OpenSSL fails a
+    /// derivation that asks for more threads than its library context
+    /// has free, and the two hashes of a gen_keys() or the calls of
+    /// several caller threads derive at the same time. So each books its
+    /// threads against the limit and takes what is left, filling its
+    /// lanes on fewer threads rather than failing.
+    struct argon2_threads_t {
+        uint32_t _threads;  ///< the threads parameter, 1 if none were booked
+
+        explicit argon2_threads_t(uint32_t wanted) : _threads(1)
         {
-            k += 1;
-            if (is_prime(k))
-                return k;
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+            if (wanted < 2)
+                return;
+            std::lock_guard<std::mutex> lock(argon2_mutex);
+            if (OSSL_get_max_threads(NULL) < wanted)
+                OSSL_set_max_threads(NULL, wanted);
+            const uint64_t limit = OSSL_get_max_threads(NULL);
+            const uint64_t available = limit > argon2_booked ? limit - argon2_booked : 0;
+            if (available < 2)
+                return;
+            _threads = static_cast<uint32_t>(std::min<uint64_t>(wanted, available));
+            argon2_booked += _threads;
+#endif
         }
-    }
 
-    bool is_prime(const int n)
-    {
-        if (n > 1000000)
-            throw Exception("argument too large");
-        if (n < 2)
-            return false;
-        else if (n % 2 == 0 || n % 3 == 0)
-            return false;
-        int i = 5;
-        while (i * i <= n)
+        ~argon2_threads_t()
         {
-            if (n % i == 0 || n % (i + 2) == 0)
-                return false;
-            i += 6;
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+            if (_threads < 2)
+                return;
+            std::lock_guard<std::mutex> lock(argon2_mutex);
+            argon2_booked -= _threads;
+#endif
         }
-        return true;
-    }
+
+    private:
+        argon2_threads_t(const argon2_threads_t&);
+        argon2_threads_t& operator=(const argon2_threads_t&);
+    };
+}
+
+namespace crypto {
 
     void sha512(
         const std::vector<uint8_t>& data,
@@ -58,63 +90,105 @@ namespace crypto {
         )
     {
         out.resize(SHA512_DIGEST_LENGTH);
-        SHA512_CTX ctx;
-        if (SHA512_Init(&ctx) != 1)
-            throw Exception("SHA512_Init");
-
-        try
-        {
-            if (SHA512_Update(&ctx, data.data(), data.size()) != 1)
-                throw Exception("SHA512_Update");
-            if (SHA512_Final(out.data(), &ctx) != 1)
-                throw Exception("SHA512_Final");
-        }
-        catch(const std::exception& e)
-        {
-            OPENSSL_cleanse(&ctx, sizeof(ctx));
-            throw;
-        }
-        OPENSSL_cleanse(&ctx, sizeof(ctx));
+        md_digest(thread_contexts_t::instance()._sha512, data.data(), data.size(), out.data());
     }
 
     void scrypt(
         const std::vector<uint8_t>& pass,
         const std::vector<uint8_t>& salt,
-        std::vector<uint8_t>& out
+        std::vector<uint8_t>& out,
+        size_t length,
+        const kdf_params_t& kdf
         )
     {
-        uint64_t const scrypt_N = 1024;
-        uint64_t const scrypt_r = 8;
-        uint64_t const scrypt_p = 16;
-        out.resize(64);
-
-        EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_SCRYPT, NULL);
-        if (pctx == 0)
-            throw Exception("EVP_PKEY_CTX_new_id failed");
-        try
+        if (!scrypt_native_verified())
         {
-            if (EVP_PKEY_derive_init(pctx) <= 0)
-                throw Exception("EVP_PKEY_derive_init");
-            if (EVP_PKEY_CTX_set1_pbe_pass(pctx, (const char*)pass.data(), pass.size()) <= 0)
-                throw("EVP_PKEY_CTX_set1_pbe_pass");
-            if (EVP_PKEY_CTX_set1_scrypt_salt(pctx, (const unsigned char*)salt.data(), salt.size()) <= 0)
-                throw("EVP_PKEY_CTX_set1_scrypt_salt");
-            if (EVP_PKEY_CTX_set_scrypt_N(pctx, scrypt_N) <= 0)
-                throw("EVP_PKEY_CTX_set_scrypt_N");
-            if (EVP_PKEY_CTX_set_scrypt_r(pctx, scrypt_r) <= 0)
-                throw("EVP_PKEY_CTX_set_scrypt_r");
-            if (EVP_PKEY_CTX_set_scrypt_p(pctx, scrypt_p) <= 0)
-                throw("EVP_PKEY_CTX_set_scrypt_p");
-            size_t keylen = out.size();
-            if (EVP_PKEY_derive(pctx, out.data(), &keylen) <= 0)
-                throw("EVP_PKEY_derive");
+            scrypt_openssl(pass, salt, out, length, kdf);
+            return;
         }
-        catch(...)
-        {
-            EVP_PKEY_CTX_free(pctx);
-            throw;
-        }
-        EVP_PKEY_CTX_free(pctx);;
+        out.resize(length);
+        scrypt_native(pass.data(), pass.size(), salt.data(), salt.size(), kdf, out.data(), out.size());
+    }
+
+    void scrypt_openssl(
+        const std::vector<uint8_t>& pass,
+        const std::vector<uint8_t>& salt,
+        std::vector<uint8_t>& out,
+        size_t length,
+        const kdf_params_t& kdf
+        )
+    {
+        uint64_t scrypt_N = kdf._scryptN;
+        uint32_t scrypt_r = kdf._scryptR;
+        uint32_t scrypt_p = kdf._scryptP;
+        // the default limit of 32 MB is below what large N and r need
+        uint64_t maxmem = kdf.memory();
+        out.resize(length);
+
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_PASSWORD, const_cast<uint8_t*>(pass.data()), pass.size()),
+            OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT, const_cast<uint8_t*>(salt.data()), salt.size()),
+            OSSL_PARAM_construct_uint64(OSSL_KDF_PARAM_SCRYPT_N, &scrypt_N),
+            OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_SCRYPT_R, &scrypt_r),
+            OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_SCRYPT_P, &scrypt_p),
+            OSSL_PARAM_construct_uint64(OSSL_KDF_PARAM_SCRYPT_MAXMEM, &maxmem),
+            OSSL_PARAM_construct_end()
+        };
+        kdf_derive(thread_contexts_t::instance()._scrypt, out.data(), out.size(), params);
+    }
+
+    void argon2id(
+        const std::vector<uint8_t>& pass,
+        const std::vector<uint8_t>& salt,
+        std::vector<uint8_t>& out,
+        size_t length,
+        const kdf_params_t& kdf
+        )
+    {
+        thread_contexts_t& contexts = thread_contexts_t::instance();
+        if (contexts._argon2id == 0)
+            throw Exception("argon2id -- not available in this OpenSSL");
+        uint32_t memory = kdf._argon2Memory;
+        uint32_t iterations = kdf._argon2Iterations;
+        uint32_t lanes = kdf._argon2Lanes;
+        // OpenSSL runs the lanes on threads of its own, up to the limit
+        // set for the library context
+        const argon2_threads_t booking(
+            std::min<uint32_t>(lanes, thread_pool_t::current().thread_count() + 1));
+        uint32_t threads = booking._threads;
+        out.resize(length);
+
+        // the parameter names of OpenSSL 3.2, spelled out so this builds
+        // against the headers of 3.0
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_PASSWORD, const_cast<uint8_t*>(pass.data()), pass.size()),
+            OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT, const_cast<uint8_t*>(salt.data()), salt.size()),
+            OSSL_PARAM_construct_uint32(OSSL_KDF_PARAM_ITER, &iterations),
+            OSSL_PARAM_construct_uint32("memcost", &memory),
+            OSSL_PARAM_construct_uint32("lanes", &lanes),
+            OSSL_PARAM_construct_uint32("threads", &threads),
+            OSSL_PARAM_construct_end()
+        };
+        kdf_derive(contexts._argon2id, out.data(), out.size(), params);
+    }
+
+    bool argon2id_available()
+    {
+        return provider_t::instance()._argon2id != 0;
+    }
+
+    void slow_hash(
+        const std::vector<uint8_t>& pass,
+        const std::vector<uint8_t>& salt,
+        std::vector<uint8_t>& out,
+        size_t length,
+        const kdf_params_t& kdf
+        )
+    {
+        if (kdf._algorithm == kdf_argon2id)
+            argon2id(pass, salt, out, length, kdf);
+        else
+            scrypt(pass, salt, out, length, kdf);
     }
 
     void hmac(
@@ -124,19 +198,162 @@ namespace crypto {
         )
     {
         result.resize(64);
-        unsigned int md_len = static_cast<unsigned int>(result.size());
-        unsigned char *res =
-            HMAC(
-                EVP_sha3_512(),                 // const EVP_MD *evp_md
-                key.data(),                     // const void *key
-                static_cast<int>(key.size()),   // int key_len
-                data.data(),                    // const unsigned char* d,
-                static_cast<int>(data.size()),  // int n
-                result.data(),                  // unsigned char* md
-                &md_len                         // unsigned int* md_len
-            );
-        if (res != result.data() || static_cast<size_t>(md_len) != result.size())
-            throw Exception("HMAC");
+        mac_compute(thread_contexts_t::instance()._hmac_sha3_512,
+                    key.data(), key.size(), data.data(), data.size(),
+                    result.data(), result.size());
+    }
+
+    namespace {
+        /// keys derived by one task when the work is split over the pool
+        const int keys_per_task = 256;
+
+        /// Checks the multi buffer HMAC against OpenSSL once
+        bool hmac_lanes_verified()
+        {
+            static std::once_flag once;
+            static bool verified = false;
+            std::call_once(once, []() {
+                // message lengths below, at and above the rate and
+                // counts that leave a short last group
+                const int lengths[] = { 16, 64, 71, 72, 73, 200 };
+                const int count = keccak_lanes + 3;
+                bool ok = true;
+                for (int len : lengths)
+                {
+                    std::vector<uint8_t> ek(len);
+                    for (int i = 0; i < len; i++)
+                        ek[i] = static_cast<uint8_t>(i * 7 + len);
+                    std::vector<uint8_t> keys(count * 64);
+                    hmac_sha3_512_counters(ek.data(), ek.size(), 0, count, keys.data());
+                    for (int i = 0; i < count; i++)
+                    {
+                        std::vector<uint8_t> pass;
+                        pushback_int(i, pass);
+                        std::vector<uint8_t> key;
+                        hmac(pass, ek, key);
+                        ok = ok && std::equal(key.begin(), key.end(), keys.begin() + i * 64);
+                    }
+                }
+                verified = ok;
+            });
+            return verified;
+        }
+    }
+
+    void hmac_keys(
+        const std::vector<uint8_t>& ek,
+        int count,
+        uint8_t* out
+        )
+    {
+        if (count <= 0)
+            return;
+        if (!hmac_lanes_verified())
+        {
+            std::vector<uint8_t> pass;
+            std::vector<uint8_t> key;
+            for (int i = 0; i < count; i++)
+            {
+                pass.clear();
+                pushback_int(i, pass);
+                hmac(pass, ek, key);
+                std::copy(key.begin(), key.end(), out + static_cast<size_t>(i) * 64);
+            }
+            OPENSSL_cleanse(key.data(), key.size());
+            return;
+        }
+        if (count <= keys_per_task)
+        {
+            hmac_sha3_512_counters(ek.data(), ek.size(), 0, count, out);
+            return;
+        }
+        task_group_t group;
+        for (int first = 0; first < count; first += keys_per_task)
+        {
+            const int n = std::min(keys_per_task, count - first);
+            group.run([&ek, first, n, out]() {
+                hmac_sha3_512_counters(ek.data(), ek.size(), first, n, out + static_cast<size_t>(first) * 64);
+            });
+        }
+        group.wait();
+    }
+
+    namespace {
+        /// bytes fetched from OpenSSL per refill of a thread's buffer
+        const size_t random_block = 4096;
+
+        /// counts the forks, a child must not hand out the bytes its
+        /// parent also holds
+        std::atomic<unsigned> fork_generation(0);
+
+        void count_fork()
+        {
+            fork_generation++;
+        }
+
+        /// The random bytes buffered by one thread
+        struct random_buffer_t {
+            uint8_t _bytes[random_block];
+            size_t _next;               ///< the first byte not handed out
+            unsigned _generation;       ///< fork_generation at the refill
+
+            random_buffer_t() : _next(random_block), _generation(0) {}
+
+            ~random_buffer_t()
+            {
+                OPENSSL_cleanse(_bytes, sizeof(_bytes));
+            }
+
+            void refill()
+            {
+                if (RAND_bytes(_bytes, random_block) != 1)
+                    throw Exception("RAND_bytes");
+                _next = 0;
+                _generation = fork_generation;
+            }
+        };
+
+        /// Returns a uniform integer in 0 .. n - 1 from the seed or the
+        /// system random generator, rejecting the values that would bias
+        /// the modulo
+        uint32_t uniform_below(rng_t* rng, uint32_t n)
+        {
+            // 2^32 mod n, the count of values at the bottom to reject
+            const uint32_t reject = static_cast<uint32_t>(-n) % n;
+            while (true)
+            {
+                uint32_t x;
+                rng->generate(reinterpret_cast<uint8_t*>(&x), sizeof(x));
+                if (x >= reject)
+                    return x % n;
+            }
+        }
+    }
+
+    void system_random_bytes(uint8_t* out, size_t size)
+    {
+        static std::once_flag once;
+        std::call_once(once, []() { pthread_atfork(0, 0, count_fork); });
+        if (size >= random_block)
+        {
+            if (RAND_bytes(out, size) != 1)
+                throw Exception("RAND_bytes");
+            return;
+        }
+        static thread_local random_buffer_t buffer;
+        if (buffer._generation != fork_generation)
+            buffer._next = random_block;
+        while (size > 0)
+        {
+            if (buffer._next == random_block)
+                buffer.refill();
+            const size_t n = std::min(size, random_block - buffer._next);
+            memcpy(out, buffer._bytes + buffer._next, n);
+            OPENSSL_cleanse(buffer._bytes + buffer._next, n);
+            buffer._next += n;
+            out += n;
+            size -= n;
+        }
     }
 
     void random_bytes(rng_t* rng, std::vector<uint8_t>& bytes)
@@ -147,10 +364,7 @@ namespace crypto {
                 bytes[i] = rng->pop();
         }
         else
-        {
-            if (RAND_bytes(static_cast<uint8_t*>(bytes.data()), bytes.size()) != 1)
-                throw Exception("RAND_bytes");
-        }
+            rng->generate(bytes.data(), bytes.size());
     }
 
     int rand(rng_t* rng)
@@ -165,17 +379,35 @@ namespace crypto {
     {
         if (!(0 < m && m <= n))
             throw Exception("rand_select -- !(0 < m && m <= n)");
-        std::vector<int> xs;
-        for (int i = 0; i < n; i++)
-            xs.push_back(i);
         std::vector<int> ans;
+        ans.reserve(m);
+        if (rng->useBytes())
+        {
+            std::vector<int> xs;
+            for (int i = 0; i < n; i++)
+                xs.push_back(i);
+            for (int i = 0; i < m; i++)
+            {
+                int k = rand(rng) % (n - i);
+                ans.push_back(xs[k + i]);
+                xs[k + i] = xs[i];
+            }
+            xs.clear();
+            return ans;
+        }
+        // The same shuffle over a virtual array xs[i] = i, holding only
+        // the entries that have been overwritten
+        std::unordered_map<int, int> moved;
+        moved.reserve(2 * m);
         for (int i = 0; i < m; i++)
         {
-            int k = rand(rng) % (n - i);
-            ans.push_back(xs[k + i]);
-            xs[k + i] = xs[i];
+            const int k = i + static_cast<int>(uniform_below(rng, static_cast<uint32_t>(n - i)));
+            const std::unordered_map<int, int>::iterator at_k = moved.find(k);
+            const std::unordered_map<int, int>::iterator at_i = moved.find(i);
+            const int x_i = at_i == moved.end() ? i : at_i->second;
+            ans.push_back(at_k == moved.end() ? k : at_k->second);
+            moved[k] = x_i;
         }
-        xs.clear();
         return ans;
     }
 }
@@ -13,23 +13,43 @@
 
 #include "types.h"
 #include "exceptions.h"
+#include "kdf.h"
+#include "drbg.h"
+#include "primes.h"
 #include <vector>
+#include <memory>
 #include <random>
 #include <algorithm>
 #include <iostream>
 
 namespace crypto {
 
+    /// Fills an array with bytes from the system random generator
+    ///
+    /// RAND_bytes is called for blocks of several KiB which each thread
+    /// buffers and hands out, so small requests do not pay for a call
+    /// into OpenSSL each. Bytes are wiped from the buffer as they are
+    /// handed out and a forked child never reuses the parent's buffer.
+    /// @param out the destination
+    /// @param size the number of bytes
+    void system_random_bytes(uint8_t* out, size_t size);
+
     /// The purpose of this object is for supplying random bytes supplied by the caller.
     /// It is also useful to produce repeatable results for debugging purposes.
+    /// A seed makes the results repeatable too, the bytes then come from
+    /// a chacha_drbg_t and there is no limit on how many are used.
     struct rng_t {
         bool _useBytes;
         size_t _i;
         std::vector<uint8_t> _randomBytes;
+        std::unique_ptr<chacha_drbg_t> _drbg;   ///< set if a seed was given
 
         /// copy of the random bytes supplied by the user to this object
         /// if the user specified the bytes
-        rng_t(std::vector<uint8_t>* randomBytes)
+        /// @param randomBytes the bytes to hand out, or null
+        /// @param seed chacha_drbg_t::seed_size bytes to generate the
+        ///     bytes from, or null
+        rng_t(std::vector<uint8_t>* randomBytes, const std::vector<uint8_t>* seed = 0)
         {
             _i = 0;
             _useBytes = false;
@@ -41,6 +61,14 @@ namespace crypto {
                     std::back_inserter(_randomBytes));
                 _useBytes = true;
             }
+            if (seed)
+            {
+                if (_useBytes)
+                    throw Exception("rng_t: both random bytes and a seed");
+                if (seed->size() != chacha_drbg_t::seed_size)
+                    throw Exception("rng_t: a seed must have 32 bytes");
+                _drbg.reset(new chacha_drbg_t(seed->data()));
+            }
         }
 
         /// clear the copy and free the memory
@@ -68,22 +96,17 @@ namespace crypto {
         {
             return _useBytes;
         }
-    };
 
-    /// tests the primality of an integers
-    ///
-    /// @param n The integer to be tested. This number must be 
-    ///         less than one million.
-    /// @returns true if n is prime else false
-    ///
-    /// Reference: https://en.wikipedia.org/wiki/Primality_test
-    bool is_prime(const int n);
-
-    /// Returns the first prime strictly greater than
-    /// a specfied integer
-    ///
-    /// @param k The exclusive lower bound on the prime
-    int first_prime_greater_than(int k);
+        /// Fills an array with the bytes of the seed, if there is one,
+        /// and from the system random generator otherwise
+        void generate(uint8_t* out, size_t size)
+        {
+            if (_drbg)
+                _drbg->generate(out, size);
+            else
+                system_random_bytes(out, size);
+        }
+    };
 
     /// returns a sha512 hash of an array of bytes
     ///
@@ -96,14 +119,62 @@ namespace crypto {
                 );
 
     /// returns a slow hash of a password
+    ///
+    /// This is computed by scrypt_native() once it has been checked
+    /// against scrypt_openssl() and by OpenSSL otherwise.
     /// @param pass an array of chars containing the password
     /// @param salt an array of bytes containing the salt
     /// @param out an array of bytes to receive the output hash
+    /// @param length the number of bytes to derive
+    /// @param kdf the cost parameters N, r and p
     void scrypt(const std::vector<uint8_t>& pass,
                 const std::vector<uint8_t>& salt,
-                std::vector<uint8_t>& out
+                std::vector<uint8_t>& out,
+                size_t length = 64,
+                const kdf_params_t& kdf = kdf_params_t()
                 );
 
+    /// Same as scrypt() but always computed by OpenSSL's SCRYPT KDF.
+    /// This is the reference the library's own scrypt is checked against.
+    void scrypt_openssl(const std::vector<uint8_t>& pass,
+                        const std::vector<uint8_t>& salt,
+                        std::vector<uint8_t>& out,
+                        size_t length = 64,
+                        const kdf_params_t& kdf = kdf_params_t()
+                        );
+
+    /// Argon2id as specified by RFC 9106, computed by OpenSSL's ARGON2ID
+    /// KDF. The lanes of the memory are filled by as many threads as the
+    /// library's thread pool has workers, plus the caller, and never more
+    /// threads than lanes. Derivations running at the same time share
+    /// that many threads and each takes what the others left, down to
+    /// one. The threads only change the time taken, not the result.
+    /// Throws an Exception if OpenSSL lacks Argon2id.
+    /// @param pass an array of chars containing the password
+    /// @param salt an array of bytes containing the salt
+    /// @param out an array of bytes to receive the output hash
+    /// @param length the number of bytes to derive
+    /// @param kdf the memory, iterations and lanes
+    void argon2id(const std::vector<uint8_t>& pass,
+                  const std::vector<uint8_t>& salt,
+                  std::vector<uint8_t>& out,
+                  size_t length,
+                  const kdf_params_t& kdf
+                  );
+
+    /// Returns true if the OpenSSL in use provides Argon2id, which it
+    /// does from version 3.2
+    bool argon2id_available();
+
+    /// Derives length bytes with the slow hash chosen by kdf, scrypt() or
+    /// argon2id()
+    void slow_hash(const std::vector<uint8_t>& pass,
+                   const std::vector<uint8_t>& salt,
+                   std::vector<uint8_t>& out,
+                   size_t length,
+                   const kdf_params_t& kdf
+                   );
+
     /// returns the hash of an array of bytes using the given key
     ///
     /// @param key An array of bytes containing the key of the hash
@@ -114,10 +185,25 @@ namespace crypto {
               std::vector<uint8_t>& result
               );
 
+    /// Derives count keys from the key material of a secret, the same
+    /// keys as count calls of hmac() keyed with the bytes of the integers
+    /// 0 .. count - 1 over ek. The keys are written one after another,
+    /// 64 bytes each. Several keys are hashed at once with a multi buffer
+    /// Keccak and large counts are split over the thread pool. If the
+    /// multi buffer code ever disagrees with OpenSSL hmac() is used.
+    /// @param ek the key material
+    /// @param count the number of keys
+    /// @param out destination of count * 64 bytes
+    void hmac_keys(const std::vector<uint8_t>& ek,
+                   int count,
+                   uint8_t* out
+                   );
+
+
     /// Fills an array with random bytes
     ///
     /// If the user supplied random bytes then use them otherwise
-    /// use a system call to generate the random bytes.
+    /// use the seed or the system random generator, see rng_t::generate().
     ///
     /// @param rng pointer to a random bytes object
     /// @param bytes a reference to an array of bytes to be filled in
@@ -131,6 +217,12 @@ namespace crypto {
 
     /// get a random selection from a set 0 .. n-1 with no repeats
     ///
+    /// With a seed or the system random generator this is a sparse Fisher-Yates
+    /// shuffle: only the displaced entries are stored, so it takes O(m)
+    /// time and memory, and each index is drawn without bias by
+    /// rejection sampling. Random bytes supplied by the user are consumed
+    /// exactly as before so that results made from them are unchanged.
+    ///
     /// @param rng pointer to a random bytes object
     /// @param n defines the range to be selected from as 0 .. n - 1
     /// @param m the number of numbers to be selected
@@ -0,0 +1,66 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <string.h>
+#include <algorithm>
+#include <openssl/crypto.h>
+#include "drbg.h"
+#include "provider.h"
+#include "exceptions.h"
+
+namespace crypto {
+
+    chacha_drbg_t::chacha_drbg_t(const uint8_t* seed) : _ctx(0), _next(block)
+    {
+        // OpenSSL's ChaCha20 IV is the 32 bit block counter followed by
+        // the 96 bit nonce, both little endian and both zero here
+        const uint8_t iv[16] = { 0 };
+        _ctx = EVP_CIPHER_CTX_new();
+        if (_ctx == 0)
+            throw Exception("EVP_CIPHER_CTX_new");
+        if (EVP_EncryptInit_ex2(_ctx, provider_t::instance()._chacha20, seed, iv, NULL) != 1)
+        {
+            EVP_CIPHER_CTX_free(_ctx);
+            throw Exception("EVP_EncryptInit_ex2");
+        }
+    }
+
+    chacha_drbg_t::~chacha_drbg_t()
+    {
+        OPENSSL_cleanse(_stream, sizeof(_stream));
+        EVP_CIPHER_CTX_free(_ctx);
+    }
+
+    void chacha_drbg_t::refill()
+    {
+        // the key stream is the encryption of zeros
+        memset(_stream, 0, block);
+        int written = 0;
+        if (EVP_EncryptUpdate(_ctx, _stream, &written, _stream, block) != 1 ||
+            written != static_cast<int>(block))
+            throw Exception("EVP_EncryptUpdate");
+        _next = 0;
+    }
+
+    void chacha_drbg_t::generate(uint8_t* out, size_t size)
+    {
+        while (size > 0)
+        {
+            if (_next == block)
+                refill();
+            const size_t n = std::min(size, block - _next);
+            memcpy(out, _stream + _next, n);
+            OPENSSL_cleanse(_stream + _next, n);
+            _next += n;
+            out += n;
+            size -= n;
+        }
+    }
+}
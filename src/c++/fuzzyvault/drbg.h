@@ -0,0 +1,60 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _DRBG_H_
+#define _DRBG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <openssl/evp.h>
+
+namespace crypto {
+
+    /// A deterministic random bit generator for reproducible parameters.
+    /// Its output is the ChaCha20 key stream (RFC 8439) with the seed as
+    /// the key and a zero nonce and counter, so the same seed always
+    /// gives the same bytes, in any quantity. The key stream is made a
+    /// block at a time and wiped as it is handed out.
+    ///
+    /// This is for tests and fixtures. A vault made from a known seed is
+    /// only as secret as the seed.
+    struct chacha_drbg_t {
+        /// bytes in a seed
+        static const size_t seed_size = 32;
+
+        /// starts the key stream of a seed
+        /// @param seed seed_size bytes
+        chacha_drbg_t(const uint8_t* seed);
+
+        /// wipes the buffered key stream
+        ~chacha_drbg_t();
+
+        /// Hands out the next bytes of the key stream
+        /// @param out the destination
+        /// @param size the number of bytes
+        /// @returns void
+        void generate(uint8_t* out, size_t size);
+
+    private:
+        /// key stream made per refill, about what one gen_params() uses
+        static const size_t block = 256;
+
+        EVP_CIPHER_CTX* _ctx;       ///< ChaCha20 keyed with the seed
+        uint8_t _stream[block];     ///< key stream not yet handed out
+        size_t _next;               ///< the first byte of _stream left
+
+        void refill();
+
+        chacha_drbg_t(const chacha_drbg_t&);
+        chacha_drbg_t& operator=(const chacha_drbg_t&);
+    };
+}
+
+#endif
@@ -0,0 +1,463 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <set>
+#include "imod.h"
+#include "poly.h"
+#include "matrix.h"
+#include "berlwelch.h"
+#include "secret.h"
+#include "engines.h"
+#include "exceptions.h"
+#include "fuzzy.h"
+
+namespace {
+    /// Berlekamp-Welch solved in place in the workspace, see berlekamp_welch()
+    struct bw_fixed_engine_t : public decode_engine_t {
+        const char* name() const { return "bw-fixed"; }
+
+        poly_t decode(const int* as,
+                      const int* bs,
+                      int n,
+                      int k,
+                      int t,
+                      decoder_workspace_t& ws
+                      ) const
+        {
+            return berlekamp_welch(as, bs, n, k, t, ws._matrix);
+        }
+    };
+
+    /// Berlekamp-Welch solved with the general purpose, heap allocated
+    /// matrix_t. This is the original formulation kept as a reference.
+    struct bw_matrix_engine_t : public decode_engine_t {
+        const char* name() const { return "bw-matrix"; }
+
+        poly_t decode(const int* as,
+                      const int* bs,
+                      int n,
+                      int k,
+                      int t,
+                      decoder_workspace_t& ws
+                      ) const
+        {
+            if (n <= 0 || n > bw_max_set_size)
+                throw Exception("berlekamp_welch: n out of range");
+            if (k <= 0 || t <= 0)
+                throw Exception("berlekamp_welch: k <= 0 || t <= 0");
+            if (k + 2 * t > n)
+                throw Exception("berlekamp_welch: k + 2 * t > n");
+            matrix_t m(n, n);
+            matrix_t y(n, 1);
+            std::vector<imod_t> apowers(k + t);
+            for (int i = 0; i < n; i++)
+            {
+                const imod_t b = bs[i];
+                imod_t::get_powers(as[i], apowers);
+                for (int j = 0; j < k + t; j++)
+                    m.set(i, j, apowers[j]);
+                for (int j = 0; j < t; j++)
+                    m.set(i, j + k + t, - (b * apowers[j]));
+                y.set(i, 0, b * apowers[t]);
+            }
+            matrix_t x = m.solve(y);
+
+            poly_t Q;
+            for (int i = 0; i < k + t; i++)
+                Q._coeffs[i] = x.get(i, 0);
+            const int e = n - k - t;
+            poly_t E;
+            for (int i = 0; i < e; i++)
+                E._coeffs[i] = x.get(k + t + i, 0);
+            E._coeffs[e] = 1;
+
+            poly_t q;
+            poly_t r;
+            poly_t::div_rem(Q, E, q, r);
+            if (r.degree() >= 0)
+                throw fuzzy_vault::NoSolutionException();
+            return q;
+        }
+    };
+
+    /// Evaluates u (of degree deg) at x
+    int evaluate(const poly_t& u, int deg, int x, int p)
+    {
+        int acc = 0;
+        for (int i = deg; i >= 0; i--)
+            acc = (acc * x + u._coeffs[i]._n) % p;
+        return acc;
+    }
+
+    /// Divides u (of degree deg) by (X - r) in place. r must be a root.
+    void deflate(poly_t& u, int deg, int r, int p)
+    {
+        int carry = 0;
+        int next = u._coeffs[deg]._n;
+        for (int i = deg; i >= 1; i--)
+        {
+            const int a = next;
+            next = u._coeffs[i - 1]._n;
+            carry = (a + r * carry) % p;
+            u._coeffs[i - 1]._n = carry;
+        }
+        u._coeffs[deg]._n = 0;
+    }
+
+    void push_root(std::vector<root_t>& roots, int x)
+    {
+        root_t r;
+        r._root = x;
+        r._count = 1;
+        roots.push_back(r);
+    }
+
+    /// Tests every element of the field, see poly_t::find_roots()
+    struct scan_root_engine_t : public root_engine_t {
+        const char* name() const { return "scan"; }
+
+        void find_roots(const poly_t& poly,
+                        const int* hints,
+                        int hint_count,
+                        std::vector<root_t>& roots
+                        ) const
+        {
+            poly_t u = poly;
+            u.find_roots(roots);
+        }
+    };
+
+    /// Tests the field elements in increasing order and divides out
+    /// each root as it is found. Once the degree reaches zero there
+    /// can be no more roots so the scan stops early.
+    struct deflate_root_engine_t : public root_engine_t {
+        const char* name() const { return "deflate"; }
+
+        void find_roots(const poly_t& poly,
+                        const int* hints,
+                        int hint_count,
+                        std::vector<root_t>& roots
+                        ) const
+        {
+            const int p = imod_t::_modulus;
+            int deg = poly.degree();
+            if (deg < 0)
+            {
+                poly_t u = poly;
+                u.find_roots(roots);
+                return;
+            }
+            poly_t u = poly;
+            for (int x = 0; x < p && deg > 0; x++)
+            {
+                if (evaluate(u, deg, x, p) != 0)
+                    continue;
+                push_root(roots, x);
+                deflate(u, deg, x, p);
+                deg--;
+            }
+        }
+    };
+
+    /// Tests the hints (the recovery words) first since most of them
+    /// are usually roots, divides them out and then scans the field for
+    /// the remaining roots with a polynomial of much lower degree.
+    struct seeded_root_engine_t : public root_engine_t {
+        const char* name() const { return "seeded"; }
+
+        void find_roots(const poly_t& poly,
+                        const int* hints,
+                        int hint_count,
+                        std::vector<root_t>& roots
+                        ) const
+        {
+            const int p = imod_t::_modulus;
+            int deg = poly.degree();
+            if (deg < 0)
+            {
+                poly_t u = poly;
+                u.find_roots(roots);
+                return;
+            }
+            poly_t u = poly;
+            for (int i = 0; i < hint_count && deg > 0; i++)
+            {
+                const int x = imod_t(hints[i])._n;
+                if (evaluate(u, deg, x, p) != 0)
+                    continue;
+                bool seen = false;
+                for (size_t j = 0; j < roots.size(); j++)
+                    seen = seen || roots[j]._root._n == x;
+                if (seen)
+                    continue;
+                push_root(roots, x);
+                deflate(u, deg, x, p);
+                deg--;
+            }
+            const size_t seeded = roots.size();
+            for (int x = 0; x < p && deg > 0; x++)
+            {
+                bool seen = false;
+                for (size_t j = 0; j < seeded; j++)
+                    seen = seen || roots[j]._root._n == x;
+                if (seen || evaluate(u, deg, x, p) != 0)
+                    continue;
+                push_root(roots, x);
+                deflate(u, deg, x, p);
+                deg--;
+            }
+            std::sort(roots.begin(), roots.end(),
+                      [](const root_t& a, const root_t& b) { return a._root._n < b._root._n; });
+        }
+    };
+
+    bool same_poly(const poly_t& a, const poly_t& b)
+    {
+        for (int i = 0; i < poly_t::_coeff_count; i++)
+        {
+            if (a._coeffs[i]._n != b._coeffs[i]._n)
+                return false;
+        }
+        return true;
+    }
+
+    bool same_roots(const std::vector<root_t>& a, const std::vector<root_t>& b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (a[i]._root._n != b[i]._root._n || a[i]._count != b[i]._count)
+                return false;
+        }
+        return true;
+    }
+
+    /// A synthetic recovery used for calibration
+    struct sample_t {
+        std::vector<int> _as;   ///< recovery words
+        std::vector<int> _bs;   ///< p_high at the recovery words
+        poly_t _p_high;
+        poly_t _p_low;          ///< reference decoder output
+        std::vector<root_t> _roots;   ///< reference root engine output
+    };
+
+    typedef std::chrono::steady_clock clock_type;
+}
+
+bool engine_registry_t::profile_t::operator<(const profile_t& other) const
+{
+    if (_setSize != other._setSize)
+        return _setSize < other._setSize;
+    if (_errorThreshold != other._errorThreshold)
+        return _errorThreshold < other._errorThreshold;
+    return _prime < other._prime;
+}
+
+engine_registry_t::engine_registry_t()
+    : _current(0)
+{
+    add(new bw_fixed_engine_t());
+    add(new bw_matrix_engine_t());
+    add(new deflate_root_engine_t());
+    add(new scan_root_engine_t());
+    add(new seeded_root_engine_t());
+}
+
+engine_registry_t& engine_registry_t::instance()
+{
+    static engine_registry_t registry;
+    return registry;
+}
+
+void engine_registry_t::add(decode_engine_t* engine)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _decoders.push_back(std::unique_ptr<decode_engine_t>(engine));
+    if (_decoders.size() == 1)
+    {
+        const snapshot_t* current = _current.load();
+        snapshot_t* next = current ? new snapshot_t(*current) : new snapshot_t();
+        next->_default._decoder = engine;
+        next->_default._calibrated = false;
+        publish(next);
+    }
+}
+
+void engine_registry_t::add(root_engine_t* engine)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _root_finders.push_back(std::unique_ptr<root_engine_t>(engine));
+    if (_root_finders.size() == 1)
+    {
+        const snapshot_t* current = _current.load();
+        snapshot_t* next = current ? new snapshot_t(*current) : new snapshot_t();
+        next->_default._roots = engine;
+        next->_default._calibrated = false;
+        publish(next);
+    }
+}
+
+void engine_registry_t::publish(snapshot_t* snapshot)
+{
+    _snapshots.push_back(std::unique_ptr<const snapshot_t>(snapshot));
+    _current.store(snapshot, std::memory_order_release);
+}
+
+engine_choice_t engine_registry_t::select(int setSize, int errorThreshold, int prime)
+{
+    const snapshot_t* snapshot = _current.load(std::memory_order_acquire);
+    const profile_t key = { setSize, errorThreshold, prime };
+    std::map<profile_t, engine_choice_t>::const_iterator it = snapshot->_choices.find(key);
+    if (it != snapshot->_choices.end())
+        return it->second;
+    return snapshot->_default;
+}
+
+engine_choice_t engine_registry_t::calibrate(int setSize, int errorThreshold, int prime)
+{
+    if (imod_t::_modulus != prime)
+        throw Exception("engine_registry_t::calibrate -- modulus is not initialized");
+    if (setSize <= 0 || setSize > bw_max_set_size || setSize >= prime)
+        throw Exception("engine_registry_t::calibrate -- bad setSize");
+    if (errorThreshold <= 0 || errorThreshold % 2 != 0 || errorThreshold >= setSize)
+        throw Exception("engine_registry_t::calibrate -- bad errorThreshold");
+
+    // engines are never removed so the pointers stay valid
+    std::vector<const decode_engine_t*> decoders;
+    std::vector<const root_engine_t*> root_finders;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t i = 0; i < _decoders.size(); i++)
+            decoders.push_back(_decoders[i].get());
+        for (size_t i = 0; i < _root_finders.size(); i++)
+            root_finders.push_back(_root_finders[i].get());
+    }
+
+    // Half of the synthetic vaults are exact matches and half carry the
+    // largest number of errors that can be corrected. The generator is
+    // seeded from the profile so calibration is repeatable.
+    const int n = setSize;
+    const int T = errorThreshold;
+    const int k = n - T;
+    const int t = T / 2;
+    const int sample_count = 16;
+    std::mt19937 gen(static_cast<unsigned>(prime * 1009 + setSize * 31 + errorThreshold));
+    std::uniform_int_distribution<int> dist(0, prime - 1);
+    decoder_workspace_t ws(n);
+    std::vector<sample_t> samples;
+    for (int s = 0; s < sample_count; s++)
+    {
+        std::set<int> chosen;
+        while (static_cast<int>(chosen.size()) < n)
+            chosen.insert(dist(gen));
+        std::vector<int> words(chosen.begin(), chosen.end());
+        std::vector<int> sketch;
+        secret_t::gen_sketch(words, T, sketch);
+        sample_t sample;
+        sample._as = words;
+        const int errors = (s % 2 == 0) ? 0 : std::min(t, prime - n);
+        for (int e = 0; e < errors; e++)
+        {
+            int x = dist(gen);
+            while (chosen.count(x))
+                x = dist(gen);
+            chosen.insert(x);
+            sample._as[e] = x;
+        }
+        std::shuffle(sample._as.begin(), sample._as.end(), gen);
+        sample._p_high = secret_t::get_phigh(sketch, n);
+        for (int i = 0; i < n; i++)
+            sample._bs.push_back(sample._p_high(sample._as[i])._n);
+        try
+        {
+            sample._p_low = decoders[0]->decode(sample._as.data(), sample._bs.data(), n, k, t, ws);
+            poly_t p_diff = sample._p_high - sample._p_low;
+            root_finders[0]->find_roots(p_diff, sample._as.data(), n, sample._roots);
+        }
+        catch (...)
+        {
+            continue;
+        }
+        samples.push_back(sample);
+    }
+    if (samples.empty())
+        throw Exception("engine_registry_t::calibrate -- no usable samples");
+
+    // best of a few passes over all samples for every engine
+    const int passes = 3;
+    engine_choice_t choice;
+    choice._decoder = decoders[0];
+    choice._roots = root_finders[0];
+    choice._calibrated = true;
+    clock_type::duration best = clock_type::duration::max();
+    for (const decode_engine_t* engine : decoders)
+    {
+        clock_type::duration fastest = clock_type::duration::max();
+        bool agrees = true;
+        for (int pass = 0; pass < passes && agrees; pass++)
+        {
+            const clock_type::time_point start = clock_type::now();
+            for (const sample_t& sample : samples)
+            {
+                try
+                {
+                    poly_t p_low = engine->decode(sample._as.data(), sample._bs.data(), n, k, t, ws);
+                    agrees = agrees && same_poly(p_low, sample._p_low);
+                }
+                catch (...)
+                {
+                    agrees = false;
+                }
+            }
+            fastest = std::min(fastest, clock_type::now() - start);
+        }
+        if (agrees && fastest < best)
+        {
+            best = fastest;
+            choice._decoder = engine;
+        }
+    }
+    best = clock_type::duration::max();
+    std::vector<root_t> roots;
+    roots.reserve(n + 1);
+    for (const root_engine_t* engine : root_finders)
+    {
+        clock_type::duration fastest = clock_type::duration::max();
+        bool agrees = true;
+        for (int pass = 0; pass < passes && agrees; pass++)
+        {
+            const clock_type::time_point start = clock_type::now();
+            for (const sample_t& sample : samples)
+            {
+                poly_t p_diff = sample._p_high - sample._p_low;
+                roots.clear();
+                engine->find_roots(p_diff, sample._as.data(), n, roots);
+                agrees = agrees && same_roots(roots, sample._roots);
+            }
+            fastest = std::min(fastest, clock_type::now() - start);
+        }
+        if (agrees && fastest < best)
+        {
+            best = fastest;
+            choice._roots = engine;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    const profile_t key = { setSize, errorThreshold, prime };
+    snapshot_t* next = new snapshot_t(*_current.load());
+    next->_choices[key] = choice;
+    publish(next);
+    return choice;
+}
@@ -0,0 +1,146 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _ENGINES_H_
+#define _ENGINES_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "poly.h"
+#include "workspace.h"
+
+/// A strategy for the first half of secret_t::recover_words(): recovering
+/// p_low from the recovery words and p_high evaluated at those words.
+/// Every engine must return exactly what berlekamp_welch() returns and
+/// throw the same exceptions.
+struct decode_engine_t {
+    virtual ~decode_engine_t() {}
+
+    /// the name reported by the public API
+    virtual const char* name() const = 0;
+
+    /// see berlekamp_welch()
+    /// @param as n recovery words
+    /// @param bs n values of p_high at the recovery words
+    /// @param n number of words
+    /// @param k setSize minus errorThreshold
+    /// @param t errorThreshold / 2
+    /// @param ws scratch space of the calling thread
+    /// @returns p_low
+    virtual poly_t decode(const int* as,
+                          const int* bs,
+                          int n,
+                          int k,
+                          int t,
+                          decoder_workspace_t& ws
+                          ) const = 0;
+};
+
+/// A strategy for the second half of secret_t::recover_words(): finding
+/// the roots of p_high - p_low. Every engine must produce the distinct
+/// roots in increasing order, each with a count of one, which is what
+/// poly_t::find_roots() produces.
+struct root_engine_t {
+    virtual ~root_engine_t() {}
+
+    /// the name reported by the public API
+    virtual const char* name() const = 0;
+
+    /// Finds the roots of a polynomial
+    /// @param poly the polynomial
+    /// @param hints values likely to be roots (the recovery words).
+    ///     Engines are free to ignore them.
+    /// @param hint_count number of hints
+    /// @param roots destination, must be empty
+    /// @returns void
+    virtual void find_roots(const poly_t& poly,
+                            const int* hints,
+                            int hint_count,
+                            std::vector<root_t>& roots
+                            ) const = 0;
+};
+
+/// The engines chosen for a profile
+struct engine_choice_t {
+    const decode_engine_t* _decoder;    ///< decodes p_low
+    const root_engine_t* _roots;        ///< finds the roots of p_high - p_low
+    bool _calibrated;                   ///< true if chosen by calibrate()
+};
+
+/// The process wide list of decode and root engines together with the
+/// choice made for each (setSize, errorThreshold, prime) profile. The
+/// first engine of each kind to be registered is the default for
+/// profiles that have not been calibrated.
+///
+/// All members are thread safe. select() runs on every recovery, so it
+/// takes no lock and allocates nothing: it reads an immutable snapshot
+/// of the choices. add() and calibrate() publish a new snapshot under
+/// the mutex and keep the old ones alive until the registry goes away,
+/// which costs one small map per calibrated profile.
+struct engine_registry_t {
+    /// (setSize, errorThreshold, prime)
+    struct profile_t {
+        int _setSize;
+        int _errorThreshold;
+        int _prime;
+
+        bool operator<(const profile_t& other) const;
+    };
+
+    /// What select() reads
+    struct snapshot_t {
+        engine_choice_t _default;                       ///< first engine of each kind
+        std::map<profile_t, engine_choice_t> _choices;  ///< calibrated choices
+    };
+
+    std::mutex _mutex;                                          ///< guards everything below
+    std::vector<std::unique_ptr<decode_engine_t>> _decoders;    ///< registered decode engines
+    std::vector<std::unique_ptr<root_engine_t>> _root_finders;  ///< registered root engines
+    std::vector<std::unique_ptr<const snapshot_t>> _snapshots;  ///< every snapshot published
+    std::atomic<const snapshot_t*> _current;                    ///< the latest snapshot
+
+    /// Returns the registry. The built in engines are registered the
+    /// first time this is called.
+    static engine_registry_t& instance();
+
+    /// Adds a decode engine. The registry takes ownership.
+    void add(decode_engine_t* engine);
+
+    /// Adds a root engine. The registry takes ownership.
+    void add(root_engine_t* engine);
+
+    /// Returns the engines to be used for a profile
+    /// @param setSize number of words
+    /// @param errorThreshold 2 * (setSize - correctThreshold)
+    /// @param prime the modulus
+    engine_choice_t select(int setSize, int errorThreshold, int prime);
+
+    /// Benchmarks every registered engine on synthetic vaults of the
+    /// given profile and caches the fastest decode and root engines.
+    /// Engines that disagree with the default engines are never chosen.
+    /// The modulus must have been set to prime with imod_t::initialize().
+    /// @param setSize number of words
+    /// @param errorThreshold 2 * (setSize - correctThreshold)
+    /// @param prime the modulus
+    /// @returns the engines chosen
+    engine_choice_t calibrate(int setSize, int errorThreshold, int prime);
+
+private:
+    engine_registry_t();
+
+    /// Makes a snapshot current. The mutex must be held.
+    void publish(snapshot_t* snapshot);
+};
+
+#endif
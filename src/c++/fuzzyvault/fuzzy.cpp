@@ -9,6 +9,10 @@
 */
 
 #include <sstream>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <functional>
 #include "fuzzy.h"
 #include "params.h"
 #include "secret.h"
@@ -18,25 +22,260 @@
 #include "imod.h"
 #include "utils.h"
 #include "exceptions.h"
+#include "engines.h"
+#include "calibration.h"
+#include "pool.h"
+#include "binary.h"
+#include "registry.h"
+#include "batchdecode.h"
+
+namespace {
+    /// Writes the engines chosen for a profile
+    std::string engine_choice_json(const engine_choice_t& choice)
+    {
+        std::stringstream output;
+        output  << "{" << std::endl
+                << "  \"decoder\": \"" << choice._decoder->name() << "\"," << std::endl
+                << "  \"rootFinder\": \"" << choice._roots->name() << "\"," << std::endl
+                << "  \"calibrated\": " << (choice._calibrated ? "true" : "false") << std::endl
+                << "}";
+        return output.str();
+    }
+
+    /// Writes items that are already JSON as a JSON array, in order
+    std::string join_array(const std::vector<std::string>& items)
+    {
+        if (items.size() == 0)
+            return "[]";
+        size_t size = 4;
+        for (const std::string& item : items)
+            size += item.size() + 2;
+        std::string output;
+        output.reserve(size);
+        output += "[\n";
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            if (i > 0)
+                output += ",\n";
+            output += items[i];
+        }
+        output += "\n]";
+        return output;
+    }
+
+    /// Throws if the recovery words cannot be those of a secret
+    void check_recovery_words(const secret_t& secret,
+                              const std::vector<int>& recovery_words
+                              )
+    {
+        if (recovery_words.size() != static_cast<size_t>(secret._setSize))
+            throw Exception("gen_keys: incorrect number of recovery words");
+        if (!utils::are_unique(recovery_words))
+            throw Exception("gen_keys: recovery words are not unique");
+    }
+
+    /// Checks the recovery words and recovers the key material of a secret
+    void recover_ek(const secret_t& secret,
+                    const std::vector<int>& recovery_words,
+                    std::vector<uint8_t>& ek
+                    )
+    {
+        check_recovery_words(secret, recovery_words);
+        std::vector<int> recovered_words;
+        secret.recover_ek(recovery_words, recovered_words, ek);
+    }
+
+    /// Writes the keys derived from the key material as the JSON array
+    /// of gen_keys() and clears the key material
+    std::string keys_json(const secret_t& secret,
+                          std::vector<uint8_t>& ek,
+                          int key_count
+                          )
+    {
+        std::stringstream keys_stream;
+        std::vector<uint8_t> keys;
+        secret.derive_keys(ek, key_count, keys);
+        std::fill(ek.begin(), ek.end(), 0);
+        if (keys.size() == 0)
+        {
+            keys_stream << "[]";
+        }
+        else
+        {
+            keys_stream << "[" << std::endl;
+            for (size_t i = 0; i < keys.size(); i += 64)
+            {
+                if (i > 0)
+                    keys_stream << "," << std::endl;
+                keys_stream << "  \"";
+                write_hex(keys_stream, &keys[i], 64) << "\"";
+            }
+            keys_stream << std::endl << "]";
+        }
+        std::fill(keys.begin(), keys.end(), 0);
+        return keys_stream.str();
+    }
+
+    /// The work of gen_keys() once the secret is parsed and the modular
+    /// tables for its prime are built
+    std::string recover_keys(const secret_t& secret,
+                             const std::string& recovery_words_string,
+                             int key_count
+                             )
+    {
+        std::vector<int> recovery_words = utils::parse_ints(recovery_words_string);
+        std::vector<uint8_t> ek;
+        recover_ek(secret, recovery_words, ek);
+        return keys_json(secret, ek, key_count);
+    }
+
+    /// A request of gen_keys_batch() on its way through the batch decoder
+    struct batch_lane_t {
+        std::vector<int> _words;        ///< the recovery words
+        std::vector<int> _candidate;    ///< the decoded words
+        int _status;                    ///< a decode_status_e, decode_error to decode on its own
+        std::exception_ptr _error;      ///< what decoding threw, see secret_t::get_candidate()
+    };
+
+    /// Decodes requests of one profile in lockstep with a batch_decoder_t
+    /// and leaves each lane with the candidate and error that
+    /// secret_t::get_candidate() gives. Lanes the batch decoder does not
+    /// take are decoded one by one as gen_keys() does. This needs the
+    /// modulus of the secrets, the hashes that check the candidates do not.
+    /// @param secrets the secret of every lane, all of one profile
+    /// @param lanes the lanes, at most batch_decoder_t::_lanes
+    void decode_lanes(const std::vector<const secret_t*>& secrets,
+                      const std::vector<batch_lane_t*>& lanes
+                      )
+    {
+        std::vector<std::vector<int>> words(lanes.size());
+        std::vector<std::vector<int>> sketches(lanes.size());
+        for (size_t k = 0; k < lanes.size(); k++)
+        {
+            words[k] = lanes[k]->_words;
+            sketches[k] = secrets[k]->_sketch;
+        }
+        std::vector<std::vector<int>> out;
+        std::vector<int> status;
+        try
+        {
+            batch_decoder_t decoder(secrets[0]->_setSize, secrets[0]->errorThreshold());
+            decoder.decode(words, sketches, out, status);
+            for (size_t k = 0; k < lanes.size(); k++)
+            {
+                lanes[k]->_candidate.swap(out[k]);
+                lanes[k]->_status = status[k];
+            }
+        }
+        catch(const Exception&)
+        {
+        }
+        std::unique_ptr<decoder_workspace_t> ws;
+        for (size_t k = 0; k < lanes.size(); k++)
+        {
+            batch_lane_t& lane = *lanes[k];
+            if (lane._status == decode_error)
+            {
+                // decoding again gives the decoder's own error
+                if (!ws)
+                    ws.reset(new decoder_workspace_t(secrets[k]->_setSize));
+                lane._error = secrets[k]->get_candidate(lane._words, lane._candidate, *ws);
+            }
+            else if (lane._status == decode_no_solution)
+            {
+                // as secret_t::get_candidate() the sorted words are tried
+                lane._candidate = lane._words;
+                std::sort(lane._candidate.begin(), lane._candidate.end());
+                lane._error = std::make_exception_ptr(fuzzy_vault::NoSolutionException());
+            }
+        }
+    }
+
+    /// The work of gen_keys() for a request decode_lanes() has seen
+    std::string recover_keys(const secret_t& secret,
+                             batch_lane_t& lane,
+                             int key_count
+                             )
+    {
+        std::vector<uint8_t> ek;
+        secret.check_candidate(lane._candidate, lane._error, ek);
+        return keys_json(secret, ek, key_count);
+    }
+
+    /// Generates the parameters of gen_params() with the given slow hash
+    std::string make_params(const input_t& input, const kdf_params_t& kdf)
+    {
+        // no modular arithmetic here, so the modulus is left alone
+        if (kdf._algorithm == kdf_argon2id && !crypto::argon2id_available())
+            throw Exception("gen_params -- argon2id needs OpenSSL 3.2 or later");
+        const int prime = crypto::first_prime_greater_than(input._corpusSize);
+        std::vector<uint8_t> randomBytes(input._randomBytes);
+        std::vector<uint8_t>* rb = randomBytes.size() > 0 ? &randomBytes : 0;
+        const std::vector<uint8_t>* seed = input._seed.size() > 0 ? &input._seed : 0;
+        params_t params(input._setSize, input._correctThreshold, input._corpusSize, prime, rb, input._version, kdf, seed);
+        std::stringstream output;
+        output << params;
+        return output.str();
+    }
+}
 
 std::string fuzzy_vault::gen_params(const std::string& input_string)
 {
     input_t input(input_string);
-    std::stringstream output;
-    try
+    return make_params(input, input._kdf);
+}
+
+std::string fuzzy_vault::gen_params_batch(const std::string& input_string, int count)
+{
+    // params made by one task of the pool
+    const int per_task = 64;
+    input_t input(input_string);
+    if (count < 0)
+        throw Exception("gen_params_batch -- count < 0");
+    if (input._kdf._algorithm == kdf_argon2id && !crypto::argon2id_available())
+        throw Exception("gen_params_batch -- argon2id needs OpenSSL 3.2 or later");
+    if (count == 0)
+        return "[]";
+    const int prime = crypto::first_prime_greater_than(input._corpusSize);
+
+    std::vector<std::string> chunks((count + per_task - 1) / per_task);
+    auto make_chunk = [&](crypto::rng_t& rng, size_t c) {
+        std::stringstream output;
+        const int first = static_cast<int>(c) * per_task;
+        const int last = std::min(count, first + per_task);
+        for (int i = first; i < last; i++)
+        {
+            params_t params(input._setSize, input._correctThreshold, input._corpusSize,
+                            prime, rng, input._version, input._kdf);
+            if (i > first)
+                output << "," << std::endl;
+            output << params;
+        }
+        chunks[c] = output.str();
+    };
+    if (input._randomBytes.size() > 0 || input._seed.size() > 0)
     {
-        const int prime = crypto::first_prime_greater_than(input._corpusSize);
-        std::vector<uint8_t>* randomBytes = input._randomBytes.size() > 0 ? &input._randomBytes : 0;
-        params_t params(input._setSize, input._correctThreshold, input._corpusSize, prime, randomBytes);
-        output << params;
+        // a single source read in order keeps the batch reproducible
+        std::vector<uint8_t>* rb = input._randomBytes.size() > 0 ? &input._randomBytes : 0;
+        const std::vector<uint8_t>* seed = input._seed.size() > 0 ? &input._seed : 0;
+        crypto::rng_t rng(rb, seed);
+        for (size_t c = 0; c < chunks.size(); c++)
+            make_chunk(rng, c);
     }
-    catch(const std::exception& e)
+    else
     {
-        imod_t::cleanup();
-        throw;
+        task_group_t group;
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            group.run([&make_chunk, c]() {
+                crypto::rng_t rng(0);
+                make_chunk(rng, c);
+            });
+        }
+        group.wait();
     }
-    imod_t::cleanup();
-    return output.str();
+
+    return join_array(chunks);
 }
 
 std::string fuzzy_vault::gen_secret(const std::string& params_string,
@@ -64,44 +303,359 @@ std::string fuzzy_vault::gen_secret(const std::string& params_string,
     return output.str();
 }
 
+std::string fuzzy_vault::gen_secret_batch(const std::string& params_string,
+                                          const std::string& words_list_string
+                                          )
+{
+    params_t params(params_string);
+    std::vector<std::vector<int>> words_list = utils::parse_int_lists(words_list_string);
+    std::vector<std::string> secrets(words_list.size());
+    imod_t::initialize(params._prime);
+    try
+    {
+        // every set is checked before any slow hash is started
+        for (const std::vector<int>& words : words_list)
+        {
+            if (!utils::are_unique(words))
+                throw Exception("gen_secret_batch -- words are not unique");
+            secret_t::check_words(words, params._setSize, params._corpusSize);
+        }
+        task_group_t group;
+        for (size_t i = 0; i < words_list.size(); i++)
+        {
+            group.run([&params, &words_list, &secrets, i]() {
+                std::stringstream output;
+                secret_t secret(params, words_list[i]);
+                output << secret;
+                secrets[i] = output.str();
+            });
+        }
+        group.wait();
+    }
+    catch(const std::exception& e)
+    {
+        imod_t::cleanup();
+        throw;
+    }
+    imod_t::cleanup();
+    return join_array(secrets);
+}
+
 std::string fuzzy_vault::gen_keys(const std::string& secret_string,
                                   const std::string& recovery_words_string,
                                   int key_count
                                  )
 {
-    std::stringstream keys_stream;
+    std::string keys;
     secret_t secret(secret_string);
     imod_t::initialize(secret._prime);
     try
     {
-        std::vector<int> recovery_words = utils::parse_ints(recovery_words_string);
-        if (recovery_words.size() != static_cast<size_t>(secret._setSize))
-            throw Exception("gen_keys: incorrect number of recovery words");
-        if (!utils::are_unique(recovery_words))
-            throw Exception("gen_keys: recovery words are not unique");
-        std::vector<std::vector<uint8_t>> keys;
-        std::vector<int> recovered_words;
+        keys = recover_keys(secret, recovery_words_string, key_count);
+    }
+    catch(...)
+    {
+        imod_t::cleanup();
+        throw;
+    }
+    imod_t::cleanup();
+    return keys;
+}
 
-        secret.recover(recovery_words, recovered_words);
-        secret.get_keys(recovered_words, key_count, keys);
-        if (keys.size() == 0)
+std::vector<fuzzy_vault::key_result_t>
+fuzzy_vault::gen_keys_batch(const std::vector<key_request_t>& requests)
+{
+    std::vector<key_result_t> results(requests.size());
+    std::vector<std::unique_ptr<secret_t>> secrets(requests.size());
+    // runs one stage of one request, turning what it throws into its result
+    auto attempt = [&results](size_t i, const std::function<void()>& stage) {
+        try
         {
-            keys_stream << "[]";
+            stage();
+            results[i]._status = key_ok;
         }
-        else
+        catch(const NoSolutionException&)
         {
-            keys_stream << "[" << std::endl;
-            bool is_first = true;
-            for(auto key : keys)
+            results[i]._status = key_no_solution;
+        }
+        catch(const std::exception& e)
+        {
+            results[i]._status = key_error;
+            results[i]._error = e.what() ? e.what() : "unknown error";
+        }
+        catch(...)
+        {
+            results[i]._status = key_error;
+            results[i]._error = "unknown error";
+        }
+    };
+
+    // the secrets are parsed first since the prime of each is needed
+    // to group the requests
+    {
+        task_group_t group;
+        for (size_t i = 0; i < requests.size(); i++)
+            group.run([&, i]() {
+                attempt(i, [&]() { secrets[i].reset(new secret_t(requests[i]._secret)); });
+            });
+        group.wait();
+    }
+
+    // The modular tables are global, so the words are decoded one prime
+    // at a time. The slow hashes that check them need no modulus and run
+    // afterwards for every prime at once.
+    std::map<int, std::vector<size_t>> by_prime;
+    for (size_t i = 0; i < requests.size(); i++)
+        if (results[i]._status == key_ok)
+            by_prime[secrets[i]->_prime].push_back(i);
+    std::vector<batch_lane_t> lanes(requests.size());
+    for (const auto& entry : by_prime)
+    {
+        try
+        {
+            imod_t::initialize(entry.first);
+        }
+        catch(const std::exception& e)
+        {
+            // a prime the tables reject fails only its own requests
+            for (size_t i : entry.second)
             {
-                if (is_first)
-                    is_first = false;
-                else
-                    keys_stream << "," << std::endl;
-                keys_stream << "  \"" << key << "\"";
+                results[i]._status = key_error;
+                results[i]._error = e.what();
             }
-            keys_stream << std::endl << "]";
+            continue;
+        }
+        try
+        {
+            // The words of each profile are decoded in lockstep, a group
+            // of batch_decoder_t::_lanes requests per task
+            std::map<std::pair<int, int>, std::vector<size_t>> by_profile;
+            for (size_t i : entry.second)
+            {
+                lanes[i]._status = decode_error;
+                attempt(i, [&]() {
+                    lanes[i]._words = utils::parse_ints(requests[i]._words);
+                    check_recovery_words(*secrets[i], lanes[i]._words);
+                });
+                if (results[i]._status == key_ok)
+                    by_profile[std::make_pair(secrets[i]->_setSize, secrets[i]->errorThreshold())].push_back(i);
+            }
+            task_group_t group;
+            for (const auto& profile : by_profile)
+                for (size_t first = 0; first < profile.second.size(); first += batch_decoder_t::_lanes)
+                {
+                    const size_t last = std::min(profile.second.size(), first + batch_decoder_t::_lanes);
+                    std::vector<const secret_t*> group_secrets;
+                    std::vector<batch_lane_t*> group_lanes;
+                    for (size_t k = first; k < last; k++)
+                    {
+                        group_secrets.push_back(secrets[profile.second[k]].get());
+                        group_lanes.push_back(&lanes[profile.second[k]]);
+                    }
+                    group.run([group_secrets, group_lanes]() { decode_lanes(group_secrets, group_lanes); });
+                }
+            group.wait();
         }
+        catch(...)
+        {
+            imod_t::cleanup();
+            throw;
+        }
+        imod_t::cleanup();
+    }
+
+    task_group_t group;
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        if (results[i]._status != key_ok)
+            continue;
+        group.run([&, i]() {
+            attempt(i, [&]() {
+                results[i]._keys = recover_keys(*secrets[i], lanes[i], requests[i]._keyCount);
+            });
+        });
+    }
+    group.wait();
+    return results;
+}
+
+std::string fuzzy_vault::register_params(const std::string& params_string)
+{
+    return params_registry_t::instance().add(params_t(params_string));
+}
+
+bool fuzzy_vault::unregister_params(const std::string& id)
+{
+    return params_registry_t::instance().erase(id);
+}
+
+std::string fuzzy_vault::compact_secret(const std::string& secret_string)
+{
+    secret_t secret(secret_string);
+    const std::string id = params_id(secret.params());
+    if (!params_registry_t::instance().find(id))
+        throw Exception("compact_secret -- the parameters of the secret are not registered");
+    std::stringstream output;
+    write_compact_json(output, secret, id);
+    return output.str();
+}
+
+std::string fuzzy_vault::expand_secret(const std::string& secret_string)
+{
+    secret_t secret(secret_string);
+    std::stringstream output;
+    output << secret;
+    return output.str();
+}
+
+std::string fuzzy_vault::calibrate_decoder(const std::string& params_string)
+{
+    // a secret carries the profile too, and its parser ignores
+    // the keys it does not use, so it reads either form
+    secret_t profile(params_string);
+    imod_t::initialize(profile._prime);
+    engine_choice_t choice;
+    try
+    {
+        choice = engine_registry_t::instance().calibrate(profile._setSize,
+                                                         profile.errorThreshold(),
+                                                         profile._prime);
+    }
+    catch(const std::exception& e)
+    {
+        imod_t::cleanup();
+        throw;
+    }
+    imod_t::cleanup();
+    return engine_choice_json(choice);
+}
+
+std::string fuzzy_vault::get_decoder(const std::string& params_string)
+{
+    secret_t profile(params_string);
+    const engine_choice_t choice =
+        engine_registry_t::instance().select(profile._setSize,
+                                             profile.errorThreshold(),
+                                             profile._prime);
+    return engine_choice_json(choice);
+}
+
+std::string fuzzy_vault::calibrate_params(const std::string& input_string,
+                                          int budget_ms,
+                                          int count
+                                          )
+{
+    input_t input(input_string);
+    if (budget_ms <= 0)
+        throw Exception("calibrate_params -- budget_ms <= 0");
+    if (count < 0)
+        throw Exception("calibrate_params -- count < 0");
+    if (input._kdf._algorithm == kdf_argon2id && !crypto::argon2id_available())
+        throw Exception("calibrate_params -- argon2id needs OpenSSL 3.2 or later");
+    // measure on a pool of our own so the process wide pool is untouched
+    kdf_calibration_t calibration;
+    {
+        thread_pool_t pool(count);
+        pool_scope_t scope(pool);
+        calibration = calibrate_kdf(input._kdf, input._version, input._setSize, budget_ms);
+    }
+    // the parameters are nested one level deeper
+    std::string params = make_params(input, calibration._kdf);
+    for (size_t i = params.find('\n'); i != std::string::npos; i = params.find('\n', i + 1))
+        params.insert(i + 1, "  ");
+    std::stringstream output;
+    output  << "{" << std::endl
+            << "  \"params\": " << params << "," << std::endl
+            << "  \"budgetMs\": " << budget_ms << "," << std::endl
+            << "  \"threads\": " << count << "," << std::endl
+            << "  \"genKeysMs\": " << calibration._genKeysMs << "," << std::endl
+            << "  \"guessMs\": " << calibration._guessMs << "," << std::endl
+            << "  \"guessMemory\": " << calibration._kdf.memory() << "," << std::endl
+            << "  \"fits\": " << (calibration._fits ? "true" : "false") << std::endl
+            << "}";
+    return output.str();
+}
+
+void fuzzy_vault::set_thread_count(int count)
+{
+    thread_pool_t::instance().set_thread_count(count);
+}
+
+fuzzy_vault::vault_params_t::vault_params_t(const std::string& json)
+    : _params(new params_t(json))
+{
+}
+
+std::string fuzzy_vault::vault_params_t::json() const
+{
+    std::stringstream output;
+    output << *_params;
+    return output.str();
+}
+
+int fuzzy_vault::vault_params_t::setSize() const
+{
+    return _params->_setSize;
+}
+
+fuzzy_vault::vault_secret_t::vault_secret_t(const std::string& json)
+    : _secret(new secret_t(json))
+{
+}
+
+fuzzy_vault::vault_secret_t::vault_secret_t(const std::shared_ptr<const secret_t>& secret)
+    : _secret(secret)
+{
+}
+
+fuzzy_vault::vault_secret_t::vault_secret_t(const vault_secret_view_t& view)
+    : _secret(new secret_t(view))
+{
+}
+
+std::vector<uint8_t> fuzzy_vault::vault_secret_t::binary() const
+{
+    std::vector<uint8_t> out;
+    write_binary(*_secret, out);
+    return out;
+}
+
+std::string fuzzy_vault::vault_secret_t::json() const
+{
+    std::stringstream output;
+    output << *_secret;
+    return output.str();
+}
+
+int fuzzy_vault::vault_secret_t::setSize() const
+{
+    return _secret->_setSize;
+}
+
+std::vector<uint8_t> fuzzy_vault::secret_to_binary(const std::string& secret)
+{
+    return vault_secret_t(secret).binary();
+}
+
+std::string fuzzy_vault::secret_to_json(const uint8_t* data, size_t size)
+{
+    return vault_secret_t(vault_secret_view_t(data, size)).json();
+}
+
+fuzzy_vault::vault_secret_t fuzzy_vault::gen_secret(const vault_params_t& params,
+                                                    const int* words,
+                                                    size_t word_count
+                                                    )
+{
+    const params_t& p = *params._params;
+    std::shared_ptr<const secret_t> secret;
+    imod_t::initialize(p._prime);
+    try
+    {
+        std::vector<int> word_list(words, words + word_count);
+        if (!utils::are_unique(word_list))
+            throw Exception("gen_secret -- words are not unique");
+        secret.reset(new secret_t(p, word_list));
     }
     catch(const std::exception& e)
     {
@@ -109,5 +663,33 @@ std::string fuzzy_vault::gen_keys(const std::string& secret_string,
         throw;
     }
     imod_t::cleanup();
-    return keys_stream.str();
-}
\ No newline at end of file
+    return vault_secret_t(secret);
+}
+
+void fuzzy_vault::gen_keys(const vault_secret_t& secret,
+                           const int* words,
+                           size_t word_count,
+                           vault_key_t* keys,
+                           int key_count
+                           )
+{
+    static_assert(sizeof(vault_key_t) == 64, "keys are packed back to back");
+    if (key_count < 0)
+        throw Exception("gen_keys -- key_count < 0");
+    const secret_t& s = *secret._secret;
+    imod_t::initialize(s._prime);
+    try
+    {
+        std::vector<uint8_t> ek;
+        recover_ek(s, std::vector<int>(words, words + word_count), ek);
+        if (key_count > 0)
+            crypto::hmac_keys(ek, key_count, keys->data());
+        std::fill(ek.begin(), ek.end(), 0);
+    }
+    catch(...)
+    {
+        imod_t::cleanup();
+        throw;
+    }
+    imod_t::cleanup();
+}
@@ -18,7 +18,14 @@
 
 #define FUZZYLIB_API_EXPORT __attribute__((visibility("default")))
 
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
+
+struct params_t;
+struct secret_t;
 
 
 
@@ -28,6 +35,12 @@
 * All arguments and return values are in the form of std::stringstream objects.
 * The strings contain JSON representation of data. It is assumed that the
 * caller has JSON parsing support.
+*
+* The functions may be called from several threads at once, except
+* set_thread_count(). The modular arithmetic of a call uses a process
+* wide modulus, the prime of its parameters, so calls for secrets with
+* different primes wait for each other in that part while calls with
+* the same prime run side by side.
 */
 namespace fuzzy_vault {
     /// This exception is thrown when the keys cannot
@@ -51,6 +64,35 @@ namespace fuzzy_vault {
             "corpusSize" : 7776
         }
 
+    An optional "version" selects the format of the secrets. Version 1,
+    the default, derives the verification hash and the key material with
+    two scrypt calls. Version 2 derives both from one scrypt call, which
+    halves the work of gen_secret() and gen_keys(). The version is
+    carried in the parameters and the secret when it is not 1.
+
+    The cost of scrypt may be set with the optional "scryptN" (a power
+    of two, default 1024), "scryptR" (default 8) and "scryptP" (default
+    16). "kdfLength" (default 64) is the number of bytes in the
+    verification hash and in the key material. These are carried in the
+    parameters and the secret when they differ from the defaults.
+
+    Parameters can be made reproducible with "seed", 32 bytes as 64 upper
+    case hex characters. The random choices are then drawn from the
+    ChaCha20 key stream of the seed, so the same input always gives the
+    same parameters. This is meant for tests and fixtures: anyone who
+    knows the seed can regenerate the salt and the extractor.
+
+    "kdf": "argon2id" selects Argon2id instead of scrypt. Its cost is set
+    with "argon2Memory" (KiB per guess, default 65536), "argon2Iterations"
+    (default 3) and "argon2Lanes" (default 4). The lanes are filled in
+    parallel by the worker threads, see set_thread_count(), so memory and
+    latency can be tuned separately. Argon2id needs OpenSSL 3.2 or later.
+
+    Whichever slow hash is chosen, one guess may take at most 2 GiB of
+    memory and fill at most 16 GiB over all its passes and lanes
+    (128 * scryptN * scryptR * scryptP bytes, or argon2Memory KiB times
+    argon2Iterations). Parameters and secrets beyond that are rejected.
+
     @returns A string containing a JSON dictionary of the following form
 
         {
@@ -69,6 +111,25 @@ namespace fuzzy_vault {
     */
     FUZZYLIB_API_EXPORT  std::string gen_params(const std::string& params_input);
 
+    /** Generates many parameters for one profile
+
+    This is gen_params() called count times, for pre-generating pools of
+    parameters. The input is parsed and the prime found once, and the
+    parameters are made on the worker threads, see set_thread_count(),
+    each drawing from its own buffered random source.
+
+    With a "seed" or "randomBytes" in the input, the parameters are
+    instead made one after the other from that single source, so the
+    whole batch is reproducible. "randomBytes" must then hold enough
+    bytes for all of them.
+
+    @param params_input the input of gen_params()
+    @param count the number of parameters to generate
+    @returns A JSON array of count parameters, each in the form that
+    gen_params() returns, written into a single string.
+    */
+    FUZZYLIB_API_EXPORT std::string gen_params_batch(const std::string& params_input, int count);
+
     /** Generates a secret to be passed into gen_keys()
 
     The secret must be stored unmodified to be used as an argument to
@@ -108,6 +169,29 @@ namespace fuzzy_vault {
                                  const std::string& words
                                 );
 
+    /** Generates the secrets of many word sets with one set of parameters
+
+    This is gen_secret() called for each set of words, for enrolling
+    many users that share one set of parameters. The parameters are
+    parsed and the modular tables built once, every set is checked
+    before any work starts, and the secrets, whose cost is almost all
+    in the slow hash, are made on the worker threads, see
+    set_thread_count().
+
+    @param params A JSON string returned by gen_params()
+    @param words_list A JSON list of lists of words, each in the form
+    gen_secret() takes
+
+        [ [ 78, 2643, 1178, ... ], [ 5011, 12, 907, ... ] ]
+
+    @returns A JSON array of the secrets, in the order of words_list,
+    each in the form that gen_secret() returns, written into a single
+    string. An error in any set of words fails the whole call.
+    */
+    FUZZYLIB_API_EXPORT std::string gen_secret_batch(const std::string& params,
+                                                     const std::string& words_list
+                                                     );
+
     /** Generates a list of keys
 
     To generate keys the caller must supply a set words (integers) that closely
@@ -155,6 +239,348 @@ namespace fuzzy_vault {
                                const std::string& words,
                                int key_count
                               );
+
+    /// The arguments of one gen_keys() call in gen_keys_batch()
+    struct key_request_t {
+        std::string _secret;    ///< a secret returned by gen_secret()
+        std::string _words;     ///< the JSON list of recovery words
+        int _keyCount;          ///< the number of keys to generate
+    };
+
+    /// How a key_request_t ended
+    enum key_status_t {
+        key_ok = 0,             ///< the keys were recovered
+        key_no_solution = 1,    ///< the words are insufficient, see NoSolutionException
+        key_error = 2           ///< the request is invalid, see key_result_t::_error
+    };
+
+    /// The outcome of one key_request_t
+    struct key_result_t {
+        int _status;            ///< a key_status_t
+        std::string _keys;      ///< what gen_keys() returns when _status is key_ok
+        std::string _error;     ///< the message of the error when _status is key_error
+
+        key_result_t() : _status(key_error) {}
+    };
+
+    /** Generates the keys of many independent requests
+
+    This is gen_keys() called for each request, for services that work
+    through queues of recoveries. The secrets are parsed and then the
+    requests recovered on the worker threads, see set_thread_count().
+    The words are decoded one prime at a time, since the modular tables
+    are shared by the process, and the words of requests with the same
+    setSize and correctThreshold eight at a time in lockstep, which
+    gives the same words as decoding them one by one. The modulus is
+    released before the slow hashes: the check of every request, of
+    every prime, is then one task, and the two slow hashes inside it
+    are tasks of their own, so an idle worker picks up whatever is
+    queued next and other calls are not held up by the hashes.
+
+    Nothing thrown by one request reaches the others or the caller:
+    each ends with its own status, the keys or the error.
+
+    @param requests the secrets, words and key counts
+    @returns one result for each request, in the same order
+    */
+    FUZZYLIB_API_EXPORT std::vector<key_result_t> gen_keys_batch(const std::vector<key_request_t>& requests);
+
+    /** Registers parameters that secrets can refer to by id
+
+    A secret normally carries a full copy of its parameters. When many
+    secrets share the parameters they can be stored in the compact form
+    of compact_secret() instead, which names the parameters by the hash
+    of their content. gen_keys() and the other functions taking a secret
+    read the compact form while its parameters are registered.
+
+    The registry belongs to the process and starts empty. A compact
+    secret stored by one process can only be read by another after that
+    process has registered the same parameters itself, so keep the
+    parameters and register them at start up, before the compact
+    secrets are used. The id depends only on the values of the
+    parameters, not on how their JSON is written.
+
+    @param params A JSON string returned by gen_params()
+    @returns the id of the parameters, 64 upper case hex characters.
+    Equal parameters always have the same id.
+    */
+    FUZZYLIB_API_EXPORT std::string register_params(const std::string& params);
+
+    /** Forgets registered parameters
+
+    @param id an id returned by register_params()
+    @returns false if the id was not registered
+    */
+    FUZZYLIB_API_EXPORT bool unregister_params(const std::string& id);
+
+    /** Writes a secret in the compact form
+
+    The secret is written with the id of its parameters in their place.
+    The parameters must have been registered with register_params()
+    first, so that the result can be read back; this throws an Exception
+    otherwise and never registers anything itself.
+
+        {
+          "paramsId": "5E0C1B9A4F ... 61D2",
+          "sketch": [ 967, 5576, 1719, 6542, 2717, 7711 ],
+          "hash": "73E8AB1883CB093F1C546D69DC87EC0FE658 ... FA975745"
+        }
+
+    @param secret A secret returned by gen_secret(), in either form
+    @returns the secret in the compact form
+    */
+    FUZZYLIB_API_EXPORT std::string compact_secret(const std::string& secret);
+
+    /** Writes a secret with its parameters included
+
+    @param secret A secret in either form. The parameters of a compact
+    secret must be registered.
+    @returns the secret in the form gen_secret() returns
+    */
+    FUZZYLIB_API_EXPORT std::string expand_secret(const std::string& secret);
+
+    /** Chooses the fastest decoder for a profile on this host
+
+    Several engines can recover the original words in gen_keys(). They
+    all give the same answer but their speed depends on setSize,
+    correctThreshold and prime. This benchmarks every engine on
+    synthetic data of the profile and remembers the fastest for the
+    rest of the process. Later calls to gen_keys() with the same
+    profile use the chosen engines.
+
+    @param params A JSON string returned by gen_params() or gen_secret().
+    Only setSize, correctThreshold and prime are used.
+
+    @returns A JSON string describing the engines chosen
+
+        {
+          "decoder": "bw-fixed",
+          "rootFinder": "seeded",
+          "calibrated": true
+        }
+    */
+    FUZZYLIB_API_EXPORT std::string calibrate_decoder(const std::string& params);
+
+    /** Reports the decoder engines gen_keys() uses for a profile
+
+    @param params A JSON string returned by gen_params() or gen_secret()
+
+    @returns A JSON string of the same form as calibrate_decoder().
+    "calibrated" is false if the profile has not been calibrated and
+    the default engines are in use.
+    */
+    FUZZYLIB_API_EXPORT std::string get_decoder(const std::string& params);
+
+    /** Generates parameters whose slow hash fits a latency budget
+
+    Choosing the cost of the slow hash by hand is guesswork since it
+    depends on the host. This benchmarks the slow hash on this host with
+    count worker threads and raises its memory and then its rounds (p
+    for scrypt, argon2Iterations for Argon2id) while the slow hashes of
+    one gen_keys() still take at most budget_ms. It then generates the
+    parameters as gen_params() does.
+
+    The measurement runs on a pool of its own and the worker threads of
+    the library are left as they are. "threads" in the result is the
+    count measured with: call set_thread_count() with it for gen_keys()
+    to run as it was measured.
+
+    @param params_input The input of gen_params(). "kdf", "scryptR",
+    "argon2Lanes", "kdfLength" and "version" are kept; the fields that
+    are searched are ignored.
+    @param budget_ms the time allowed for the slow hashes of gen_keys()
+    @param count the number of worker threads to measure with
+    @returns A JSON string of the following form
+
+        {
+          "params": { ... the output of gen_params() ... },
+          "budgetMs": 250,
+          "threads": 3,
+          "genKeysMs": 201.5,
+          "guessMs": 101.2,
+          "guessMemory": 16779264,
+          "fits": true
+        }
+
+    genKeysMs is the measured time of the slow hashes of gen_keys() and
+    guessMs the time of the verification hash, the work of testing one
+    guess of the words, which takes guessMemory bytes. "fits" is false
+    if even the cheapest parameters exceed the budget; the cheapest are
+    returned then.
+    */
+    FUZZYLIB_API_EXPORT std::string calibrate_params(const std::string& params_input,
+                                                     int budget_ms,
+                                                     int count
+                                                     );
+
+    /** Sets the number of worker threads used inside a library call
+
+    gen_keys() evaluates the check of the recovered words and the key
+    material at the same time on a small pool of worker threads. By
+    default the pool has one thread less than the hardware provides.
+    The results never depend on the number of threads.
+
+    This must not be called while another thread is inside the library.
+
+    @param count the number of worker threads. Zero runs everything on
+    the calling thread.
+    */
+    FUZZYLIB_API_EXPORT void set_thread_count(int count);
+
+    /*
+    * The typed API
+    *
+    * The same operations for callers that already hold their data in
+    * C++ form. Parameters and secrets are parsed once into the values
+    * below and words and keys are passed as plain arrays, so no JSON is
+    * parsed or written on the way. The values convert to and from the
+    * JSON strings of the functions above and give the same results.
+    */
+
+    /// One key of gen_keys()
+    typedef std::array<uint8_t, 64> vault_key_t;
+
+    class vault_secret_t;
+
+    /** A secret in the binary format, read in place
+
+    The binary format holds the same fields as the JSON of gen_secret()
+    in about a third of the space: field elements in two bytes, the salt
+    and the hash as raw bytes, behind a small header with the profile
+    and the cost of the slow hash. A view reads the fields straight from
+    the caller's memory, for example a mapped file of many secrets laid
+    end to end, and copies nothing. The memory must outlive the view.
+    */
+    class FUZZYLIB_API_EXPORT vault_secret_view_t {
+    public:
+        /// Checks the header and that the buffer holds the whole secret.
+        /// The buffer may continue past it, see size().
+        /// @param data the first byte of the secret
+        /// @param size bytes available at data
+        vault_secret_view_t(const uint8_t* data, size_t size);
+
+        const uint8_t* data() const { return _data; }   ///< the first byte
+        size_t size() const { return _size; }           ///< bytes of the secret
+
+        int version() const;            ///< the version of the secret
+        int setSize() const;            ///< the number of words
+        int correctThreshold() const;   ///< words that must match
+        int corpusSize() const;         ///< the number of possible words
+        int prime() const;              ///< the modulus of the field
+        int sketchSize() const;         ///< elements of the sketch
+        size_t saltSize() const;        ///< bytes of the salt
+        size_t hashSize() const;        ///< bytes of the hash
+
+        /// @param i 0 .. setSize() - 1
+        /// @returns element i of the extractor
+        int extractor(int i) const;
+
+        /// @param i 0 .. sketchSize() - 1
+        /// @returns element i of the sketch
+        int sketch(int i) const;
+
+        const uint8_t* salt() const;    ///< the salt, saltSize() bytes
+        const uint8_t* hash() const;    ///< the hash, hashSize() bytes
+
+    private:
+        const uint8_t* _data;
+        size_t _size;
+    };
+
+    /// Parsed parameters, see gen_params(). Copies share the parsed data.
+    class FUZZYLIB_API_EXPORT vault_params_t {
+    public:
+        /// Parses the parameters
+        /// @param json A JSON string returned by gen_params()
+        explicit vault_params_t(const std::string& json);
+
+        /// Returns the parameters in the form gen_params() returns
+        std::string json() const;
+
+        /// Returns the number of words of a secret made with them
+        int setSize() const;
+
+    private:
+        std::shared_ptr<const params_t> _params;
+
+        friend vault_secret_t gen_secret(const vault_params_t&, const int*, size_t);
+    };
+
+    /// A parsed secret, see gen_secret(). Copies share the parsed data.
+    class FUZZYLIB_API_EXPORT vault_secret_t {
+    public:
+        /// Parses the secret
+        /// @param json A JSON string returned by gen_secret()
+        explicit vault_secret_t(const std::string& json);
+
+        /// Reads a secret in the binary format
+        /// @param view the secret
+        explicit vault_secret_t(const vault_secret_view_t& view);
+
+        /// Returns the secret in the form gen_secret() returns
+        std::string json() const;
+
+        /// Returns the secret in the binary format, see vault_secret_view_t
+        std::vector<uint8_t> binary() const;
+
+        /// Returns the number of words the secret was made from
+        int setSize() const;
+
+    private:
+        explicit vault_secret_t(const std::shared_ptr<const secret_t>& secret);
+
+        std::shared_ptr<const secret_t> _secret;
+
+        friend vault_secret_t gen_secret(const vault_params_t&, const int*, size_t);
+        friend void gen_keys(const vault_secret_t&, const int*, size_t, vault_key_t*, int);
+    };
+
+    /** Generates a secret, see gen_secret()
+
+    @param params the parameters
+    @param words setSize unique words in the range 0 .. corpusSize - 1
+    @param word_count the number of words
+    @returns the secret
+    */
+    FUZZYLIB_API_EXPORT vault_secret_t gen_secret(const vault_params_t& params,
+                                                  const int* words,
+                                                  size_t word_count
+                                                  );
+
+    /** Converts a secret to the binary format
+
+    @param secret A JSON string returned by gen_secret()
+    @returns the secret in the binary format, see vault_secret_view_t.
+    secret_to_json() of it returns the same string.
+    */
+    FUZZYLIB_API_EXPORT std::vector<uint8_t> secret_to_binary(const std::string& secret);
+
+    /** Converts a secret in the binary format to JSON
+
+    @param data the secret in the binary format
+    @param size bytes available at data
+    @returns the secret in the form gen_secret() returns
+    */
+    FUZZYLIB_API_EXPORT std::string secret_to_json(const uint8_t* data, size_t size);
+
+    /** Generates keys, see gen_keys()
+
+    Throws NoSolutionException if the words are not close enough to the
+    original words, just as gen_keys() does.
+
+    @param secret the secret
+    @param words the recovery words
+    @param word_count the number of words, which must equal setSize
+    @param keys destination of key_count keys
+    @param key_count the number of keys
+    @returns void
+    */
+    FUZZYLIB_API_EXPORT void gen_keys(const vault_secret_t& secret,
+                                      const int* words,
+                                      size_t word_count,
+                                      vault_key_t* keys,
+                                      int key_count
+                                      );
 };
 
 #endif
@@ -0,0 +1,177 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "fuzzyc.h"
+#include "fuzzy.h"
+#include "crypto.h"
+#include "input.h"
+#include "params.h"
+#include "secret.h"
+#include "exceptions.h"
+
+namespace {
+    thread_local const char* last_error = "";
+
+    /// The size of the JSON of any parameters gen_params() makes from
+    /// input, counting the NUL. Only the extractor varies in length and
+    /// its elements are below the prime, so parameters with every element
+    /// at prime - 1 are the longest. Nothing random is drawn.
+    size_t params_bound(const std::string& input_json)
+    {
+        const input_t input(input_json);
+        const int prime = crypto::first_prime_greater_than(input._corpusSize);
+        const params_t widest(input._setSize, input._correctThreshold, input._corpusSize, prime,
+                              std::vector<int>(input._setSize, prime - 1),
+                              std::vector<uint8_t>(params_salt_size),
+                              input._version, input._kdf);
+        std::stringstream json;
+        json << widest;
+        return json.str().size() + 1;
+    }
+
+    /// The size of the JSON of any secret gen_secret() makes from params,
+    /// counting the NUL. The sketch is written at full width as above and
+    /// the slow hash is not run.
+    size_t secret_bound(const std::string& params_json)
+    {
+        params_t params(params_json);
+        std::fill(params._extractor.begin(), params._extractor.end(), params._prime - 1);
+        const int errorThreshold = 2 * (params._setSize - params._correctThreshold);
+        const secret_t widest(params,
+                              std::vector<int>(std::max(errorThreshold, 0), params._prime - 1),
+                              std::vector<uint8_t>(params._kdf._length));
+        std::stringstream json;
+        json << widest;
+        return json.str().size() + 1;
+    }
+
+    /// Answers a size query by the size convention of fuzzyc.h
+    /// @param needed the bound of the result, counting the NUL
+    /// @param out the destination of the caller
+    /// @param size the capacity of out, set to needed
+    /// @returns true if out can take any result, false to return
+    ///     FUZZY_BUFFER_TOO_SMALL without making one
+    bool fits(size_t needed, const char* out, size_t* size)
+    {
+        const size_t capacity = *size;
+        *size = needed;
+        return out != 0 && capacity >= needed;
+    }
+
+    /// Copies text out, fits() having said it fits
+    int write_text(const std::string& text, char* out)
+    {
+        memcpy(out, text.c_str(), text.size() + 1);
+        return FUZZY_OK;
+    }
+
+    /// Runs the body of an export and turns what it throws into a status
+    template <typename F>
+    int guarded(F body)
+    {
+        try
+        {
+            return body();
+        }
+        catch(const fuzzy_vault::NoSolutionException&)
+        {
+            return FUZZY_NO_SOLUTION;
+        }
+        catch(const std::bad_alloc&)
+        {
+            return FUZZY_OUT_OF_MEMORY;
+        }
+        catch(const Exception& e)
+        {
+            // the messages of Exception are string literals
+            last_error = e.what();
+        }
+        catch(...)
+        {
+            last_error = "internal error";
+        }
+        return FUZZY_ERROR;
+    }
+}
+
+const char* fuzzy_last_error(void)
+{
+    return last_error;
+}
+
+int fuzzy_gen_params(const char* input,
+                     size_t input_len,
+                     char* out,
+                     size_t* size
+                     )
+{
+    if (input == 0 || size == 0)
+        return FUZZY_INVALID_ARGUMENT;
+    return guarded([&]() -> int {
+        const std::string text(input, input_len);
+        if (!fits(params_bound(text), out, size))
+            return FUZZY_BUFFER_TOO_SMALL;
+        return write_text(fuzzy_vault::gen_params(text), out);
+    });
+}
+
+int fuzzy_gen_secret(const char* params,
+                     size_t params_len,
+                     const int* words,
+                     size_t word_count,
+                     char* out,
+                     size_t* size
+                     )
+{
+    if (params == 0 || (words == 0 && word_count > 0) || size == 0)
+        return FUZZY_INVALID_ARGUMENT;
+    return guarded([&]() -> int {
+        const std::string text(params, params_len);
+        if (!fits(secret_bound(text), out, size))
+            return FUZZY_BUFFER_TOO_SMALL;
+        const fuzzy_vault::vault_params_t p(text);
+        return write_text(fuzzy_vault::gen_secret(p, words, word_count).json(), out);
+    });
+}
+
+int fuzzy_gen_keys(const char* secret,
+                   size_t secret_len,
+                   const int* words,
+                   size_t word_count,
+                   uint8_t* keys,
+                   int key_count
+                   )
+{
+    if (secret == 0 || (words == 0 && word_count > 0) || key_count < 0 || (keys == 0 && key_count > 0))
+        return FUZZY_INVALID_ARGUMENT;
+    static_assert(sizeof(fuzzy_vault::vault_key_t) == FUZZY_KEY_SIZE, "keys are packed back to back");
+    return guarded([&]() -> int {
+        const fuzzy_vault::vault_secret_t s(std::string(secret, secret_len));
+        fuzzy_vault::gen_keys(s, words, word_count,
+                              reinterpret_cast<fuzzy_vault::vault_key_t*>(keys), key_count);
+        return FUZZY_OK;
+    });
+}
+
+int fuzzy_set_thread_count(int count)
+{
+    if (count < 0)
+        return FUZZY_INVALID_ARGUMENT;
+    return guarded([&]() -> int {
+        fuzzy_vault::set_thread_count(count);
+        return FUZZY_OK;
+    });
+}
@@ -0,0 +1,125 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _FUZZYC_H_
+#define _FUZZYC_H_
+
+/**
+* Fuzzy Vault C exports
+*
+* The functions of fuzzy.h for callers that cannot catch C++ exceptions
+* or take C++ strings, such as cgo, Rust and N-API hosts. Every function
+* returns a fuzzy_status_t and writes its results into buffers supplied
+* by the caller, so no memory allocated by the library is handed across.
+* Parameters and secrets are the same JSON text as in fuzzy.h, passed as
+* a pointer and a length, and need not be terminated.
+*
+* Text is returned with the size convention
+*
+*     size_t size = 0;
+*     fuzzy_gen_params(input, len, NULL, &size);      // FUZZY_BUFFER_TOO_SMALL
+*     char* out = malloc(size);
+*     fuzzy_gen_params(input, len, out, &size);       // FUZZY_OK
+*
+* On entry *size is the capacity of out. On return it is the number of
+* bytes the result needs, counting the terminating NUL. Parameters and
+* secrets are random and their text varies slightly in length, so for
+* them the size is the most any result for the same input can need and
+* a buffer of that size always fits the next call.
+*
+* The functions may be called from several threads at once, except
+* fuzzy_set_thread_count(), see the notes in fuzzy.h.
+*
+* The size is worked out from the input alone before anything is
+* generated. A size query costs no slow hash, and a caller who already
+* has a large enough buffer gets the result from the first call.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FUZZYC_API_EXPORT __attribute__((visibility("default")))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// The outcome of a call
+typedef enum {
+    FUZZY_OK = 0,                   ///< done
+    FUZZY_NO_SOLUTION = 1,          ///< the words are insufficient to recover the keys
+    FUZZY_BUFFER_TOO_SMALL = 2,     ///< nothing was written, see the size convention
+    FUZZY_INVALID_ARGUMENT = 3,     ///< a required pointer is null or a count is negative
+    FUZZY_OUT_OF_MEMORY = 4,        ///< an allocation failed
+    FUZZY_ERROR = 5                 ///< the input was rejected, see fuzzy_last_error()
+} fuzzy_status_t;
+
+/// The number of bytes in one key written by fuzzy_gen_keys()
+#define FUZZY_KEY_SIZE 64
+
+/// Returns a description of the last FUZZY_ERROR of the calling thread.
+/// The text is static and stays valid for the life of the process.
+FUZZYC_API_EXPORT const char* fuzzy_last_error(void);
+
+/// Generates parameters, see fuzzy_vault::gen_params()
+/// @param input the JSON input of gen_params()
+/// @param input_len bytes in input
+/// @param out destination of the parameters, may be null to query the size
+/// @param size the capacity of out on entry, the size needed on return
+/// @returns a fuzzy_status_t
+FUZZYC_API_EXPORT int fuzzy_gen_params(const char* input,
+                                       size_t input_len,
+                                       char* out,
+                                       size_t* size
+                                       );
+
+/// Generates a secret, see fuzzy_vault::gen_secret()
+/// @param params parameters returned by fuzzy_gen_params()
+/// @param params_len bytes in params
+/// @param words the words
+/// @param word_count the number of words
+/// @param out destination of the secret, may be null to query the size
+/// @param size the capacity of out on entry, the size needed on return
+/// @returns a fuzzy_status_t
+FUZZYC_API_EXPORT int fuzzy_gen_secret(const char* params,
+                                       size_t params_len,
+                                       const int* words,
+                                       size_t word_count,
+                                       char* out,
+                                       size_t* size
+                                       );
+
+/// Generates keys, see fuzzy_vault::gen_keys()
+/// @param secret a secret returned by fuzzy_gen_secret()
+/// @param secret_len bytes in secret
+/// @param words the recovery words
+/// @param word_count the number of words
+/// @param keys destination of key_count * FUZZY_KEY_SIZE bytes
+/// @param key_count the number of keys
+/// @returns a fuzzy_status_t, FUZZY_NO_SOLUTION if the words are not
+/// close enough to the original words
+FUZZYC_API_EXPORT int fuzzy_gen_keys(const char* secret,
+                                     size_t secret_len,
+                                     const int* words,
+                                     size_t word_count,
+                                     uint8_t* keys,
+                                     int key_count
+                                     );
+
+/// Sets the number of worker threads, see fuzzy_vault::set_thread_count()
+/// @param count the number of worker threads
+/// @returns a fuzzy_status_t
+FUZZYC_API_EXPORT int fuzzy_set_thread_count(int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
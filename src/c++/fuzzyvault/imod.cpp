@@ -11,15 +11,72 @@
 #include <iostream>
 #include <iomanip>
 #include <memory.h>
-#include <assert.h>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
 #include "imod.h"
 #include "crypto.h"
 #include "types.h"
 #include "exceptions.h"
 
 int imod_t::_modulus = 0;
-int* imod_t::_inverses = 0;
+const int* imod_t::_inverses = 0;
+
+namespace {
+    /// guards the modulus and the counts below
+    std::mutex modulus_mutex;
+    /// signalled when the last user of a modulus leaves
+    std::condition_variable modulus_released;
+    /// calls between initialize() and cleanup()
+    int modulus_users = 0;
+    /// the ticket the next call to initialize() draws
+    unsigned long long modulus_tickets = 0;
+    /// the ticket of the next call to be let in, calls enter in turn
+    unsigned long long modulus_turn = 0;
+
+    /// the table of the held modulus, guarded by modulus_mutex
+    std::shared_ptr<const std::vector<int>> modulus_table;
+
+    /// tables kept for the moduli used last, a table is at most 128 KiB
+    const size_t cached_tables = 16;
+
+    /// Returns the inverses modulo a prime. The tables of the last few
+    /// primes are kept, the prime comes from untrusted input so holding
+    /// every one seen could take hundreds of MiB. A dropped table is made
+    /// again in about 0.1 ms, and callers still using it keep it alive.
+    std::shared_ptr<const std::vector<int>> inverse_table(int p)
+    {
+        typedef std::pair<int, std::shared_ptr<const std::vector<int>>> entry_t;
+        static std::mutex mutex;
+        static std::list<entry_t> tables;   // the most recently used first
+        std::lock_guard<std::mutex> lock(mutex);
+        for (std::list<entry_t>::iterator it = tables.begin(); it != tables.end(); ++it)
+            if (it->first == p)
+            {
+                tables.splice(tables.begin(), tables, it);
+                return it->second;
+            }
+        std::shared_ptr<std::vector<int>> table(new std::vector<int>);
+        imod_inverses(p, *table);
+        tables.push_front(entry_t(p, table));
+        if (tables.size() > cached_tables)
+            tables.pop_back();
+        return table;
+    }
+}
+
 
+void imod_inverses(int p, std::vector<int>& inv)
+{
+    // i * (p / i) + p % i = 0 (mod p), so 1/i = -(p / i) / (p % i)
+    // with p % i < i, which fills the table in one pass
+    inv.assign(p, 0);
+    if (p > 1)
+        inv[1] = 1;
+    for (int i = 2; i < p; i++)
+        inv[i] = p - (p / i) * inv[p % i] % p;
+}
 
 imod_t imod_t::operator-() const
 {
@@ -90,40 +147,44 @@ bool operator!=(const imod_t a, imod_t b)
 
 void imod_t::initialize(int modulus)
 {
-    assert(_modulus == 0);
-    assert(_inverses == 0);
     if (modulus <= 0)
         throw Exception("invalid value for the modulus");
     if (!(crypto::is_prime(modulus)))
         throw Exception("modulus is not prime");
     if (modulus > 0x8000)
         throw Exception("modulus is too large");
-    _inverses = new int[modulus];
-    if (_inverses == 0)
-        throw Exception("failed to allocae _inverses");
-    _modulus = modulus;
-    _inverses[0] = 0;
-    for (int i = 1; i < _modulus; i++)
+    std::shared_ptr<const std::vector<int>> inverses = inverse_table(modulus);
+    std::unique_lock<std::mutex> lock(modulus_mutex);
+    // Calls are let in in the order they arrive. One joins the holders
+    // of its modulus only when every earlier call is in, so a steady
+    // stream of one prime queues behind a call for another and cannot
+    // starve it.
+    const unsigned long long ticket = modulus_tickets++;
+    while (ticket != modulus_turn || (modulus_users > 0 && _modulus != modulus))
+        modulus_released.wait(lock);
+    modulus_turn++;
+    if (modulus_users++ == 0)
     {
-        for (int j = i; j < _modulus; j++)
-        {
-            if (((i * j) % _modulus) == 1)
-            {
-                _inverses[i] = j;
-                _inverses[j] = i;
-            }
-        }
+        modulus_table = inverses;
+        _inverses = inverses->data();
+        _modulus = modulus;
     }
+    // the next in line may share the modulus too
+    lock.unlock();
+    modulus_released.notify_all();
 }
 
 void imod_t::cleanup()
 {
-    if (_inverses != 0)
-    {
-        delete _inverses;
-        _inverses = 0;
-    }
+    std::unique_lock<std::mutex> lock(modulus_mutex);
+    if (modulus_users == 0 || --modulus_users > 0)
+        return;
+    // the table may stay in the cache for the next call with this modulus
+    _inverses = 0;
     _modulus = 0;
+    modulus_table.reset();
+    lock.unlock();
+    modulus_released.notify_all();
 }
 
 imod_t::imod_t(int n)
@@ -149,12 +210,17 @@ std::ostream& operator<<(std::ostream& os, const imod_t imod)
 }
 
 void imod_t::get_powers(int a, std::vector<imod_t>& out)
+{
+    get_powers(a, out.data(), static_cast<int>(out.size()));
+}
+
+void imod_t::get_powers(int a, imod_t* out, int count)
 {
     const imod_t x = imod_t(a);
     imod_t y = imod_t(1);
-    for (size_t i = 0; i < out.size(); i++)
+    for (int i = 0; i < count; i++)
     {
         out[i] = y;
         y = y * x;
-    }   
+    }
 }
@@ -17,7 +17,7 @@
 /// A structure containing a single integer, a modular value
 struct imod_t {
     static int _modulus;    ///< This is the global modulus for all numbers
-    static int* _inverses;  ///< This is an pre-computed array of inverses of the modular numbers
+    static const int* _inverses;  ///< This is an pre-computed array of inverses of the modular numbers
 
     int _n; ///< The value of the modular number it must be in the range 0 .. _modulus - 1 */
 
@@ -45,16 +45,26 @@ struct imod_t {
     
     /// Establishes the value of the modulus for all modular numbers
     /// in the process. This must be done at the beginning. The
-    /// global array _inverses is allocaed and filled, so
-    /// cleanup() must be called at the end of the process.
+    /// global array _inverses points at a table of the inverses that
+    /// is shared by every call holding the modulus and kept for later
+    /// calls while the modulus is among the few used last,
+    /// cleanup() must be called at the end of the call.
+    ///
+    /// Calls on several threads may hold the modulus at once as long as
+    /// they use the same one. A call for another modulus blocks here
+    /// until every holder has called cleanup(). Calls are let in in the
+    /// order they arrive, so a call for the held modulus waits behind an
+    /// earlier call for another one. A thread must not call this again
+    /// before its cleanup().
     ///
     /// @param modulus The value of the global modulus
     /// @returns void
     static void initialize(int modulus);
 
-    /// Cleanup all global resources allocated to support 
-    /// modular arithmetic. This must be called at
-    /// the end of the process.
+    /// Releases the global modulus. When the last holder releases it
+    /// another can be set. The table of inverses stays cached for the
+    /// next use of the modulus unless newer moduli push it out. This must be called at the end of the call,
+    /// once for every successful initialize().
     ///
     /// @returns void
     static void cleanup();
@@ -75,8 +85,38 @@ struct imod_t {
     ///     of a
     /// @returns void
     static void get_powers(int a, std::vector<imod_t>& out);
+
+    /// Fills a buffer with the powers [1, a, a^2, ..., a^(count-1)]
+    ///
+    /// @param a The value to be used
+    /// @param out destination for count modular values
+    /// @param count the number of powers to be written
+    /// @returns void
+    static void get_powers(int a, imod_t* out, int count);
 };
 
+/// Returns (a * b) mod p for values already reduced modulo p.
+/// The modulus is at most 0x8000 so the product fits in an int.
+inline int imod_mul(int a, int b, int p)
+{
+    return (a * b) % p;
+}
+
+/// Returns (a - f * b) mod p for values already reduced modulo p
+inline int imod_mul_sub(int a, int f, int b, int p)
+{
+    const int v = a - (f * b) % p;
+    return v < 0 ? v + p : v;
+}
+
+/// Computes the table of inverses that initialize() caches for a
+/// modulus, inv[i] * i = 1 (mod p) for i in 1 .. p - 1 and inv[0] = 0.
+///
+/// @param p a prime, at most 0x8000
+/// @param inv set to the p entries of the table
+/// @returns void
+void imod_inverses(int p, std::vector<int>& inv);
+
 imod_t operator+(const imod_t a, const imod_t b);
 imod_t operator-(const imod_t a, const imod_t b);
 imod_t operator*(const imod_t a, const imod_t b);
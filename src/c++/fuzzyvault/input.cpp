@@ -11,6 +11,7 @@
 #include "input.h"
 #include "types.h"
 #include "parsing.h"
+#include "drbg.h"
 #include "exceptions.h"
 
 std::ostream& operator<<(std::ostream& os, const input_t& input)
@@ -18,7 +19,11 @@ std::ostream& operator<<(std::ostream& os, const input_t& input)
     os  << "{" << std::endl
         << "  \"setSize\": " << std::dec << input._setSize << "," << std::endl
         << "  \"corpusSize\": " << std::dec << input._corpusSize << "," << std::endl
-        << "  \"correctThreshold\": " << std::dec << input._correctThreshold << std::endl
+        << "  \"correctThreshold\": " << std::dec << input._correctThreshold;
+    if (input._version != vault_version_1)
+        os << "," << std::endl << "  \"version\": " << std::dec << input._version;
+    write_kdf_json(os, input._kdf);
+    os  << std::endl
         << "}";
     return os;
 }
@@ -29,12 +34,18 @@ input_t::input_t(const std::string& json)
     const std::string corpusSize_s("corpusSize");
     const std::string correctThreshold_s("correctThreshold");
     const std::string randomBytes_s("randomBytes");
+    const std::string version_s("version");
+    const std::string seed_s("seed");
+    _version = vault_version_1;
     struct json_value_s* root = json_parse(json.c_str(), json.length());
 
     bool set_setSize = false;
     bool set_corpusSize = false;
     bool set_correctThreshold = false;
     bool set_randomBytes = false;
+    bool set_version = false;
+    bool set_seed = false;
+    unsigned kdf_seen = 0;
 
     if (root == 0)
         throw Exception("input_t:input_t -- json_parse failed");
@@ -46,7 +57,7 @@ input_t::input_t(const std::string& json)
         if (object == 0)
             throw Exception("input_t::input_t -- root->payload is null");
         json_object_element_s* E = object->start;
-        if (object->length != 3 && object->length != 4)
+        if (object->length < 3)
             throw Exception("input_t::input_t -- bad number of key-value pairs");
         for (size_t i = 0; i < object->length; i++, E = E->next) 
         {
@@ -81,7 +92,21 @@ input_t::input_t(const std::string& json)
                 json_read_bytes_ex(E, _randomBytes);
                 set_randomBytes = true;
             }
-            else
+            else if (version_s.compare(name) == 0)
+            {
+                if (set_version)
+                    throw Exception("input_t::input_t -- version set more than once");
+                json_read_int(E, _version);
+                set_version = true;
+            }
+            else if (seed_s.compare(name) == 0)
+            {
+                if (set_seed)
+                    throw Exception("input_t::input_t -- seed set more than once");
+                json_read_bytes(E, _seed);
+                set_seed = true;
+            }
+            else if (!json_read_kdf(E, _kdf, kdf_seen))
                 throw Exception("input_t::input_t -- unrecognized key value");
         }
     }
@@ -97,4 +122,8 @@ input_t::input_t(const std::string& json)
         throw Exception("correctThreshold is not set");
     if (!set_corpusSize)
         throw Exception("corpusSize is not set");
+    if (set_seed && set_randomBytes)
+        throw Exception("input_t::input_t -- both seed and randomBytes are set");
+    if (set_seed && _seed.size() != crypto::chacha_drbg_t::seed_size)
+        throw Exception("input_t::input_t -- seed must have 32 bytes");
 }
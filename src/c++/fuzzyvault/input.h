@@ -14,7 +14,9 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <stdint.h>
+#include "params.h"
 
 /// This structure defines the parameters of the key recovery scheme
 /// This information will be passed to gen_secret()
@@ -22,7 +24,10 @@ struct input_t {
     int _setSize;            ///< The number of words required to generate keys
     int _correctThreshold;   ///< The number of correct words required to generate keys
     int _corpusSize;         ///< The number of word to choose from
+    int _version;            ///< The format of the secrets, see vault_version_1
+    kdf_params_t _kdf;       ///< The cost of the slow hash
     std::vector<uint8_t> _randomBytes;
+    std::vector<uint8_t> _seed;     ///< drives the random bytes if not empty
 
     /// Initial constructor
     /// @param setSize value for setSize
@@ -31,7 +36,8 @@ struct input_t {
     input_t(int setSize,
             int correctThreshold,
             int corpusSize
-            ) : _setSize(setSize), _correctThreshold(correctThreshold), _corpusSize(corpusSize)
+            ) : _setSize(setSize), _correctThreshold(correctThreshold), _corpusSize(corpusSize),
+                _version(vault_version_1)
             {}
 
     /// Construct from a JSON representation
@@ -41,6 +47,7 @@ struct input_t {
     ~input_t()
     {
         _randomBytes.clear();
+        std::fill(_seed.begin(), _seed.end(), 0);
     }
 };
 
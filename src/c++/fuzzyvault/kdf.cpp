@@ -0,0 +1,182 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <string>
+#include "kdf.h"
+#include "parsing.h"
+#include "exceptions.h"
+
+namespace {
+    const int max_scrypt_N = 1 << 22;       ///< 4 GiB with r = 8
+    const int max_scrypt_R = 64;
+    const int max_scrypt_P = 1024;
+    const int max_argon2_memory = 1 << 22;  ///< 4 GiB
+    const int max_argon2_iterations = 1024;
+    const int max_argon2_lanes = 255;
+    const int min_length = 16;
+    const int max_length = 512;
+
+    /// The fields above bound each cost on its own, these bound what
+    /// they add up to so parameters read from a payload cannot tie up a
+    /// machine: at most 2 GiB of memory for one guess and 16 GiB of
+    /// memory written and read back over all passes and lanes. That is
+    /// more than calibrate_kdf() ever chooses.
+    const unsigned long long max_memory = 1ULL << 31;
+    const unsigned long long max_traffic = 1ULL << 34;
+
+    const unsigned seen_scryptN = 1;
+    const unsigned seen_scryptR = 2;
+    const unsigned seen_scryptP = 4;
+    const unsigned seen_length = 8;
+    const unsigned seen_algorithm = 16;
+    const unsigned seen_argon2Memory = 32;
+    const unsigned seen_argon2Iterations = 64;
+    const unsigned seen_argon2Lanes = 128;
+
+    const char* algorithm_names[] = { "scrypt", "argon2id" };
+}
+
+void kdf_params_t::check() const
+{
+    if (_algorithm != kdf_scrypt && _algorithm != kdf_argon2id)
+        throw Exception("kdf_params_t::check -- unknown kdf");
+    if (_scryptN < 2 || _scryptN > max_scrypt_N || (_scryptN & (_scryptN - 1)) != 0)
+        throw Exception("kdf_params_t::check -- scryptN is not a power of two in range");
+    if (_scryptR < 1 || _scryptR > max_scrypt_R)
+        throw Exception("kdf_params_t::check -- scryptR out of range");
+    if (_scryptP < 1 || _scryptP > max_scrypt_P)
+        throw Exception("kdf_params_t::check -- scryptP out of range");
+    if (_argon2Lanes < 1 || _argon2Lanes > max_argon2_lanes)
+        throw Exception("kdf_params_t::check -- argon2Lanes out of range");
+    // Argon2 needs at least 8 KiB per lane
+    if (_argon2Memory < 8 * _argon2Lanes || _argon2Memory > max_argon2_memory)
+        throw Exception("kdf_params_t::check -- argon2Memory out of range");
+    if (_argon2Iterations < 1 || _argon2Iterations > max_argon2_iterations)
+        throw Exception("kdf_params_t::check -- argon2Iterations out of range");
+    if (_length < min_length || _length > max_length)
+        throw Exception("kdf_params_t::check -- kdfLength out of range");
+    if (memory() > max_memory)
+        throw Exception("kdf_params_t::check -- the kdf needs too much memory");
+    if (traffic() > max_traffic)
+        throw Exception("kdf_params_t::check -- the kdf is too slow");
+}
+
+size_t kdf_params_t::memory() const
+{
+    if (_algorithm == kdf_argon2id)
+        return static_cast<size_t>(_argon2Memory) << 10;
+    // the N blocks of ROMix, two working blocks and the p lanes of B
+    const size_t block = 128 * static_cast<size_t>(_scryptR);
+    return block * (static_cast<size_t>(_scryptN) + 2 + static_cast<size_t>(_scryptP));
+}
+
+unsigned long long kdf_params_t::traffic() const
+{
+    if (_algorithm == kdf_argon2id)
+        return (static_cast<unsigned long long>(_argon2Memory) << 10) * _argon2Iterations;
+    // every lane fills N blocks and reads them back
+    return 128ULL * _scryptR * _scryptN * _scryptP;
+}
+
+bool json_read_kdf(const json_object_element_s* E,
+                   kdf_params_t& kdf,
+                   unsigned& seen
+                  )
+{
+    const std::string scryptN_s("scryptN");
+    const std::string scryptR_s("scryptR");
+    const std::string scryptP_s("scryptP");
+    const std::string length_s("kdfLength");
+    const std::string algorithm_s("kdf");
+    const std::string argon2Memory_s("argon2Memory");
+    const std::string argon2Iterations_s("argon2Iterations");
+    const std::string argon2Lanes_s("argon2Lanes");
+    const char* name = E->name->string;
+    int* dst = 0;
+    unsigned bit = 0;
+    if (scryptN_s.compare(name) == 0)
+    {
+        dst = &kdf._scryptN;
+        bit = seen_scryptN;
+    }
+    else if (scryptR_s.compare(name) == 0)
+    {
+        dst = &kdf._scryptR;
+        bit = seen_scryptR;
+    }
+    else if (scryptP_s.compare(name) == 0)
+    {
+        dst = &kdf._scryptP;
+        bit = seen_scryptP;
+    }
+    else if (length_s.compare(name) == 0)
+    {
+        dst = &kdf._length;
+        bit = seen_length;
+    }
+    else if (argon2Memory_s.compare(name) == 0)
+    {
+        dst = &kdf._argon2Memory;
+        bit = seen_argon2Memory;
+    }
+    else if (argon2Iterations_s.compare(name) == 0)
+    {
+        dst = &kdf._argon2Iterations;
+        bit = seen_argon2Iterations;
+    }
+    else if (argon2Lanes_s.compare(name) == 0)
+    {
+        dst = &kdf._argon2Lanes;
+        bit = seen_argon2Lanes;
+    }
+    else if (algorithm_s.compare(name) == 0)
+        bit = seen_algorithm;
+    else
+        return false;
+    if (seen & bit)
+        throw Exception("json_read_kdf -- KDF parameter set more than once");
+    seen |= bit;
+    if (dst)
+    {
+        json_read_int(E, *dst);
+        return true;
+    }
+    std::string algorithm;
+    json_read_string(E, algorithm);
+    if (algorithm == algorithm_names[kdf_scrypt])
+        kdf._algorithm = kdf_scrypt;
+    else if (algorithm == algorithm_names[kdf_argon2id])
+        kdf._algorithm = kdf_argon2id;
+    else
+        throw Exception("json_read_kdf -- unknown kdf");
+    return true;
+}
+
+std::ostream& write_kdf_json(std::ostream& os, const kdf_params_t& kdf)
+{
+    const kdf_params_t defaults;
+    if (kdf._algorithm != defaults._algorithm)
+        os << "," << std::endl << "  \"kdf\": \"" << algorithm_names[kdf._algorithm] << "\"";
+    if (kdf._scryptN != defaults._scryptN)
+        os << "," << std::endl << "  \"scryptN\": " << std::dec << kdf._scryptN;
+    if (kdf._scryptR != defaults._scryptR)
+        os << "," << std::endl << "  \"scryptR\": " << std::dec << kdf._scryptR;
+    if (kdf._scryptP != defaults._scryptP)
+        os << "," << std::endl << "  \"scryptP\": " << std::dec << kdf._scryptP;
+    if (kdf._length != defaults._length)
+        os << "," << std::endl << "  \"kdfLength\": " << std::dec << kdf._length;
+    if (kdf._argon2Memory != defaults._argon2Memory)
+        os << "," << std::endl << "  \"argon2Memory\": " << std::dec << kdf._argon2Memory;
+    if (kdf._argon2Iterations != defaults._argon2Iterations)
+        os << "," << std::endl << "  \"argon2Iterations\": " << std::dec << kdf._argon2Iterations;
+    if (kdf._argon2Lanes != defaults._argon2Lanes)
+        os << "," << std::endl << "  \"argon2Lanes\": " << std::dec << kdf._argon2Lanes;
+    return os;
+}
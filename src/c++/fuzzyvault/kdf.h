@@ -0,0 +1,82 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _KDF_H_
+#define _KDF_H_
+
+#include <ostream>
+#include "json.h"
+
+/// the slow hashes a vault can be created with
+const int kdf_scrypt = 0;
+const int kdf_argon2id = 1;
+
+/// The choice and cost parameters of the slow hash used to derive the
+/// verification hash and the key material. They are chosen when the
+/// parameters are generated and carried unchanged into the secret.
+///
+/// The defaults are the values the library has always used. Parameters
+/// equal to their default are not written to JSON, so payloads created
+/// before these parameters existed read and write unchanged.
+///
+/// Argon2id sets its memory per guess and its parallelism independently:
+/// the lanes are filled at the same time by up to as many threads, see
+/// crypto::argon2id().
+struct kdf_params_t {
+    int _algorithm;         ///< kdf_scrypt or kdf_argon2id
+    int _scryptN;           ///< CPU and memory cost, a power of two
+    int _scryptR;           ///< block size
+    int _scryptP;           ///< parallelization
+    int _argon2Memory;      ///< memory cost in KiB
+    int _argon2Iterations;  ///< passes over the memory
+    int _argon2Lanes;       ///< lanes of the memory, filled in parallel
+    int _length;            ///< bytes in the verification hash and in the key material
+
+    /// constructs the default parameters
+    kdf_params_t() : _algorithm(kdf_scrypt),
+                     _scryptN(1024), _scryptR(8), _scryptP(16),
+                     _argon2Memory(65536), _argon2Iterations(3), _argon2Lanes(4),
+                     _length(64) {}
+
+    /// Throws an Exception if the parameters are out of range or if the
+    /// chosen slow hash would need more memory or time than a guess
+    /// should ever take, see memory() and traffic()
+    /// @returns void
+    void check() const;
+
+    /// Returns the bytes of memory the chosen slow hash needs with these
+    /// parameters
+    size_t memory() const;
+
+    /// Returns the bytes of memory one run of the chosen slow hash fills
+    /// over all its lanes and passes, a measure of its time
+    unsigned long long traffic() const;
+};
+
+/// Reads one key-value pair if its key names a KDF parameter
+/// @param E a json object element
+/// @param kdf the destination of the value
+/// @param seen bit mask of the KDF parameters read so far. Used to
+///     reject parameters set more than once.
+/// @returns true if the key names a KDF parameter
+bool json_read_kdf(const json_object_element_s* E,
+                   kdf_params_t& kdf,
+                   unsigned& seen
+                   );
+
+/// Writes the KDF parameters that differ from their defaults as JSON
+/// key-value pairs, each preceded by a comma and a new line, so this
+/// follows the last key-value pair of an object.
+/// @param os the stream
+/// @param kdf the parameters
+/// @returns os
+std::ostream& write_kdf_json(std::ostream& os, const kdf_params_t& kdf);
+
+#endif
@@ -0,0 +1,262 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <string.h>
+#include <vector>
+#include <openssl/crypto.h>
+#include "keccak.h"
+
+namespace {
+    /// One Keccak state word of every instance. The compiler maps the
+    /// operations to AVX2, two SSE2 (or NEON) registers or scalar code
+    /// depending on the target. On x86 an AVX2 build of the hash is
+    /// chosen at run time, see sha3_512_lanes().
+    typedef uint64_t lanes_t __attribute__((vector_size(8 * crypto::keccak_lanes)));
+
+    const uint64_t round_constants[24] = {
+        0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+        0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+        0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+        0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+        0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+        0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+        0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+        0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+    };
+
+    const int rotations[24] = {
+        1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14,
+        27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44
+    };
+
+    const int pi_lanes[24] = {
+        10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4,
+        15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1
+    };
+
+    // a macro rather than a function, returning a vector wider than the
+    // target's registers would trip the ABI warning of -Wpsabi
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+// Everything below sha3_512_lanes() is inlined into it so that each
+// build of it gets its own copy compiled for its instruction set.
+#define KECCAK_INLINE inline __attribute__((always_inline))
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KECCAK_AVX2_DISPATCH
+#endif
+
+    /// Keccak-f[1600] of every instance
+    KECCAK_INLINE void keccak_f(lanes_t st[25])
+    {
+        lanes_t bc[5];
+        for (int round = 0; round < 24; round++)
+        {
+            // theta
+            for (int i = 0; i < 5; i++)
+                bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+            for (int i = 0; i < 5; i++)
+            {
+                const lanes_t t = bc[(i + 4) % 5] ^ ROTL(bc[(i + 1) % 5], 1);
+                for (int j = 0; j < 25; j += 5)
+                    st[j + i] ^= t;
+            }
+            // rho and pi
+            lanes_t t = st[1];
+            for (int i = 0; i < 24; i++)
+            {
+                const int j = pi_lanes[i];
+                const lanes_t next = st[j];
+                st[j] = ROTL(t, rotations[i]);
+                t = next;
+            }
+            // chi
+            for (int j = 0; j < 25; j += 5)
+            {
+                for (int i = 0; i < 5; i++)
+                    bc[i] = st[j + i];
+                for (int i = 0; i < 5; i++)
+                    st[j + i] ^= ~bc[(i + 1) % 5] & bc[(i + 2) % 5];
+            }
+            // iota
+            const uint64_t rc = round_constants[round];
+            lanes_t c;
+            for (int l = 0; l < crypto::keccak_lanes; l++)
+                c[l] = rc;
+            st[0] ^= c;
+        }
+    }
+
+    KECCAK_INLINE uint64_t le64dec(const uint8_t* p)
+    {
+        uint64_t x = 0;
+        for (int i = 7; i >= 0; i--)
+            x = (x << 8) | p[i];
+        return x;
+    }
+
+    KECCAK_INLINE void le64enc(uint8_t* p, uint64_t x)
+    {
+        for (int i = 0; i < 8; i++, x >>= 8)
+            p[i] = x & 0xff;
+    }
+
+    /// xors one rate sized block of every instance into the state
+    KECCAK_INLINE void absorb(lanes_t st[25], const uint8_t* const* blocks)
+    {
+        for (int i = 0; i < crypto::sha3_512_rate / 8; i++)
+        {
+            lanes_t w;
+            for (int l = 0; l < crypto::keccak_lanes; l++)
+                w[l] = le64dec(blocks[l] + 8 * i);
+            st[i] ^= w;
+        }
+    }
+
+    /// HMAC-SHA3-512 of data keyed with the bytes of each of keccak_lanes integers
+    void hmac_lanes(const int* counters,
+                    const uint8_t* data,
+                    size_t len,
+                    std::vector<uint8_t>& inner,
+                    std::vector<uint8_t>& outer,
+                    uint8_t* const* out
+                    )
+    {
+        const int B = crypto::sha3_512_rate;
+        const int L = crypto::keccak_lanes;
+        const size_t inner_len = B + len;
+        const size_t outer_len = B + 64;
+        const uint8_t* in[L];
+        uint8_t* inner_hash[L];
+        for (int l = 0; l < L; l++)
+        {
+            // the key is shorter than a block so it is zero padded
+            uint8_t key[B];
+            memset(key, 0, B);
+            memcpy(key, &counters[l], sizeof(int));
+            uint8_t* ipad = &inner[l * inner_len];
+            uint8_t* opad = &outer[l * outer_len];
+            for (int i = 0; i < B; i++)
+            {
+                ipad[i] = key[i] ^ 0x36;
+                opad[i] = key[i] ^ 0x5c;
+            }
+            memcpy(ipad + B, data, len);
+            in[l] = ipad;
+            inner_hash[l] = opad + B;
+        }
+        crypto::sha3_512_lanes(in, inner_len, inner_hash);
+        for (int l = 0; l < L; l++)
+            in[l] = &outer[l * outer_len];
+        crypto::sha3_512_lanes(in, outer_len, out);
+    }
+
+    /// SHA3-512 of keccak_lanes messages, see crypto::sha3_512_lanes()
+    KECCAK_INLINE void sha3_512_lanes_body(const uint8_t* const* in,
+                                           size_t len,
+                                           uint8_t* const* out
+                                           )
+    {
+        const int L = crypto::keccak_lanes;
+        lanes_t st[25];
+        for (int i = 0; i < 25; i++)
+            for (int l = 0; l < L; l++)
+                st[i][l] = 0;
+        const uint8_t* blocks[L];
+        size_t offset = 0;
+        for (; len - offset >= static_cast<size_t>(crypto::sha3_512_rate); offset += crypto::sha3_512_rate)
+        {
+            for (int l = 0; l < L; l++)
+                blocks[l] = in[l] + offset;
+            absorb(st, blocks);
+            keccak_f(st);
+        }
+        // the SHA3 domain bits and pad10*1 in the last block
+        uint8_t last[L][crypto::sha3_512_rate];
+        const size_t rest = len - offset;
+        for (int l = 0; l < L; l++)
+        {
+            memset(last[l], 0, crypto::sha3_512_rate);
+            memcpy(last[l], in[l] + offset, rest);
+            last[l][rest] ^= 0x06;
+            last[l][crypto::sha3_512_rate - 1] ^= 0x80;
+            blocks[l] = last[l];
+        }
+        absorb(st, blocks);
+        keccak_f(st);
+        for (int l = 0; l < L; l++)
+            for (int i = 0; i < 8; i++)
+                le64enc(out[l] + 8 * i, st[i][l]);
+        OPENSSL_cleanse(last, sizeof(last));
+        OPENSSL_cleanse(st, sizeof(st));
+    }
+
+    void sha3_512_lanes_default(const uint8_t* const* in, size_t len, uint8_t* const* out)
+    {
+        sha3_512_lanes_body(in, len, out);
+    }
+
+#if defined(KECCAK_AVX2_DISPATCH)
+    __attribute__((target("avx2")))
+    void sha3_512_lanes_avx2(const uint8_t* const* in, size_t len, uint8_t* const* out)
+    {
+        sha3_512_lanes_body(in, len, out);
+    }
+#endif
+}
+
+namespace crypto {
+
+    void sha3_512_lanes(const uint8_t* const* in,
+                        size_t len,
+                        uint8_t* const* out
+                        )
+    {
+#if defined(KECCAK_AVX2_DISPATCH)
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        if (avx2)
+        {
+            sha3_512_lanes_avx2(in, len, out);
+            return;
+        }
+#endif
+        sha3_512_lanes_default(in, len, out);
+    }
+
+    void hmac_sha3_512_counters(const uint8_t* data,
+                                size_t len,
+                                int first,
+                                int count,
+                                uint8_t* out
+                                )
+    {
+        const int B = sha3_512_rate;
+        const int L = keccak_lanes;
+        std::vector<uint8_t> inner(L * (B + len));
+        std::vector<uint8_t> outer(L * (B + 64));
+        uint8_t spare[L][64];
+        for (int k = 0; k < count; k += L)
+        {
+            // a short last group repeats its final key and drops the copies
+            int counters[L];
+            uint8_t* dst[L];
+            for (int l = 0; l < L; l++)
+            {
+                const bool used = k + l < count;
+                counters[l] = first + (used ? k + l : count - 1);
+                dst[l] = used ? out + static_cast<size_t>(k + l) * 64 : spare[l];
+            }
+            hmac_lanes(counters, data, len, inner, outer, dst);
+        }
+        OPENSSL_cleanse(inner.data(), inner.size());
+        OPENSSL_cleanse(outer.data(), outer.size());
+        OPENSSL_cleanse(spare, sizeof(spare));
+    }
+}
@@ -0,0 +1,57 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _KECCAK_H_
+#define _KECCAK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace crypto {
+
+    /// number of SHA3-512 instances computed together by sha3_512_lanes()
+    const int keccak_lanes = 4;
+
+    /// bytes absorbed per Keccak-f[1600] permutation by SHA3-512
+    const int sha3_512_rate = 72;
+
+    /// Computes keccak_lanes SHA3-512 hashes of messages of the same
+    /// length at once. The Keccak state is lane sliced, every state word
+    /// is a vector holding that word of every instance, so each step of
+    /// the permutation is one vector operation over all instances.
+    /// @param in keccak_lanes messages of len bytes each
+    /// @param len length of every message
+    /// @param out keccak_lanes destinations of 64 bytes each
+    /// @returns void
+    void sha3_512_lanes(const uint8_t* const* in,
+                        size_t len,
+                        uint8_t* const* out
+                        );
+
+    /// Computes HMAC-SHA3-512 with the bytes of each of the integers
+    /// first .. first + count - 1 as the key and data as the message,
+    /// which is how the keys of a secret are derived from its ek. The
+    /// keys are written one after the other, 64 bytes each, and are
+    /// identical to those of hmac().
+    /// @param data the message, ek
+    /// @param len bytes in data
+    /// @param first the first key index
+    /// @param count the number of keys
+    /// @param out destination of count * 64 bytes
+    /// @returns void
+    void hmac_sha3_512_counters(const uint8_t* data,
+                                size_t len,
+                                int first,
+                                int count,
+                                uint8_t* out
+                                );
+}
+
+#endif
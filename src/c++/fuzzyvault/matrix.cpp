@@ -11,11 +11,165 @@
 #include <iostream>
 #include <iomanip>
 #include <memory.h>
+#include <utility>
 #include "types.h"
 #include "matrix.h"
 #include "exceptions.h"
 #include "fuzzy.h"
 
+void matrix_view_t::check_row(int row) const
+{
+    if (!(0 <= row && row < _nRows))
+        throw Exception("row out of range");
+}
+
+void matrix_view_t::swap_rows(int row1,
+                              int row2
+                              )
+{
+    if (row1 == row2)
+        return;
+    imod_t* r1 = row(row1);
+    imod_t* r2 = row(row2);
+    for (int col = 0; col < _nCols; col++)
+        std::swap(r1[col], r2[col]);
+}
+
+int matrix_view_t::find_pivot_row(int h, int k) const
+{
+    for (int i = h; i < _nRows; i++)
+    {
+        if (row(i)[k]._n != 0)
+            return i;
+    }
+    return -1;
+}
+
+void matrix_view_t::echelon()
+{
+    const int p = imod_t::_modulus;
+    int h = 0;
+    int k = 0;
+    while (h < _nRows && k < _nCols)
+    {
+        const int pivot_row = find_pivot_row(h, k);
+        if (pivot_row < 0)
+        {
+            k++;
+            continue;
+        }
+        swap_rows(h, pivot_row);
+        imod_t* rh = row(h);
+        const int scale = rh[k].inv()._n;
+        for (int j = k; j < _nCols; j++)
+            rh[j]._n = imod_mul(scale, rh[j]._n, p);
+        for (int i = h + 1; i < _nRows; i++)
+        {
+            imod_t* ri = row(i);
+            const int f = ri[k]._n;
+            if (f == 0)
+                continue;
+            ri[k]._n = 0;
+            for (int j = k + 1; j < _nCols; j++)
+                ri[j]._n = imod_mul_sub(ri[j]._n, f, rh[j]._n, p);
+        }
+        h++;
+        k++;
+    }
+}
+
+int matrix_view_t::count_null_rows() const
+{
+    int count = 0;
+    for (int r = _nRows - 1; r >= 0; r--)
+    {
+        const imod_t* values = row(r);
+        for (int col = 0; col < _nCols; col++)
+        {
+            if (values[col]._n != 0)
+                return count;
+        }
+        count += 1;
+    }
+    return count;
+}
+
+bool matrix_view_t::is_singular() const
+{
+    for (int r = 0; r < _nRows; r++)
+    {
+        if (row(r)[r]._n == 0)
+            return true;
+    }
+    return false;
+}
+
+void matrix_view_t::back_substitute()
+{
+    const int p = imod_t::_modulus;
+    const int last = _nCols - 1;
+    for (int r = _nRows - 1; r > 0; r--)
+    {
+        const int b = row(r)[last]._n;
+        for (int r1 = r - 1; r1 >= 0; r1--)
+        {
+            imod_t* values = row(r1);
+            values[last]._n = imod_mul_sub(values[last]._n, values[r]._n, b, p);
+            values[r]._n = 0;
+        }
+    }
+}
+
+bool matrix_view_t::solve_solvable_singular(int null_count, imod_t* x)
+{
+    const int p = imod_t::_modulus;
+    const int last = _nCols - 1;
+    for (int r = 0; r < _nRows; r++)
+        x[r]._n = 0;
+    for (int r = _nRows - null_count - 1; r >= 0; r--)
+    {
+        const imod_t* rr = row(r);
+        int col = 0;
+        while (col < _nCols && rr[col]._n != 1)
+            col++;
+        // no leading one or a leading one in the right hand side
+        // column means the equations are inconsistent
+        if (col >= last)
+            return false;
+        x[col] = rr[last];
+        for (int r1 = r - 1; r1 >= 0; r1--)
+        {
+            imod_t* values = row(r1);
+            const int f = values[col]._n;
+            if (f == 0)
+                continue;
+            values[col]._n = 0;
+            for (int col1 = col + 1; col1 < _nCols; col1++)
+                values[col1]._n = imod_mul_sub(values[col1]._n, f, rr[col1]._n, p);
+        }
+    }
+    return true;
+}
+
+bool matrix_view_t::solve(imod_t* x)
+{
+    if (_nCols != _nRows + 1)
+        throw Exception("Matrix not augmented correctly");
+    echelon();
+    if (is_singular())
+    {
+        const int null_count = count_null_rows();
+        if (null_count == 0)
+            return false;
+        return solve_solvable_singular(null_count, x);
+    }
+    back_substitute();
+    const int last = _nCols - 1;
+    for (int r = 0; r < _nRows; r++)
+        x[r] = row(r)[last];
+    return true;
+}
+
 matrix_t::matrix_t(int nrows,
                    int ncols
                    ) : _nRows(nrows), _nCols(ncols)
@@ -155,14 +309,7 @@ void matrix_t::swap_rows(int row1,
 {
     validate_row(row1);
     validate_row(row2);
-    if (row1 == row2)
-        return;
-    for (int col = 0; col < _nCols; col++)
-    {
-        const imod_t t = get(row1, col);
-        set(row1, col, get(row2, col));
-        set(row2, col, t);
-    }
+    view().swap_rows(row1, row2);
 }
 
 int matrix_t::get_pivot_row(int h, int k) const
@@ -172,43 +319,23 @@ int matrix_t::get_pivot_row(int h, int k) const
         if (get(i, k) != 0)
             return i;
     }
-    throw GetPivotRowException();
+    return -1;
 }
 
-void matrix_t::pivot(int h,
+bool matrix_t::pivot(int h,
                      int k
                      )
 {
-    swap_rows(h, get_pivot_row(h, k));
+    const int row = get_pivot_row(h, k);
+    if (row < 0)
+        return false;
+    swap_rows(h, row);
+    return true;
 }
 
 void matrix_t::echelon()
 {
-    int h = 0;
-    int k = 0;
-    while (h < _nRows && k < _nCols)
-    {
-        try
-        {
-            pivot(h, k);
-            const imod_t scale = get(h, k).inv();
-            for (int i = k; i < _nCols; i++)
-                set(h, i, scale * get(h, i));
-            for (int i = h + 1; i < _nRows; i++)
-            {
-                const imod_t f = get(i, k);
-                set(i, k, 0);
-                for (int j = k + 1; j < _nCols; j++)
-                    set(i, j, get(i, j) - (get(h, j) * f));
-            }
-            h++;
-            k++;
-        }
-        catch (GetPivotRowException)
-        {
-            k++;
-        }
-    }
+    view().echelon();
 }
 
 const matrix_t operator*(const matrix_t&a,
@@ -233,16 +360,7 @@ const matrix_t operator*(const matrix_t&a,
 
 void matrix_t::back_substitute()
 {
-    const int last = _nCols - 1;
-    for (int row = _nRows - 1; row > 0; row--)
-    {
-        for (int row1 = row - 1; row1 >= 0; row1--)
-        {
-            const imod_t temp = get(row1, row) * get(row, last);
-            set(row1, row, 0);
-            set(row1, last, get(row1, last) - temp);
-        }
-    }
+    view().back_substitute();
 }
 
 matrix_t matrix_t::solve_normal_case()
@@ -277,29 +395,18 @@ matrix_t matrix_t::solve_singular_case()
 matrix_t matrix_t::solve_solvable_singular(int null_count)
 {
     matrix_t X(_nRows, 1);
-    for (int row = _nRows - null_count - 1; row >= 0; row--)
-    {
-        const int col = find_leading_one(row);
-        X.set(col, 0, get(row, _nCols - 1));
-        for (int row1 = row - 1; row1 >= 0; row1--)
-        {
-            const imod_t f = get(row1, col);
-            set(row1, col, 0);
-            for (int col1 = col + 1; col1 < _nCols; col1++)
-                set(row1, col1, get(row1, col1) - (f * get(row, col1)));
-        }
-    }
+    if (!view().solve_solvable_singular(null_count, X._buf.data()))
+        throw fuzzy_vault::NoSolutionException();
     return X;
 }
 
 matrix_t matrix_t::solve(const matrix_t& B)
 {
     matrix_t A = augment(B);
-    A.echelon();
-    if (A.is_singular())
-        return A.solve_singular_case();
-    else
-        return A.solve_normal_case();
+    matrix_t X(_nRows, 1);
+    if (!A.view().solve(X._buf.data()))
+        throw fuzzy_vault::NoSolutionException();
+    return X;
 }
 
 std::ostream& operator<<(std::ostream& os,
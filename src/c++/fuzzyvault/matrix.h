@@ -13,11 +13,128 @@
 
 #include "types.h"
 #include "imod.h"
+#include "exceptions.h"
 #include <vector>
 
-/// An exception internal to the matrix_t class. It is used
-/// to indicate that the search of a pivot failed.
-class GetPivotRowException {};
+/// Bounds checking in the unchecked kernels (matrix_view_t) is only
+/// compiled into debug builds, that is when NDEBUG is not defined.
+/// Define MATRIX_CHECKED explicitly to force the checks on.
+#if !defined(NDEBUG) && !defined(MATRIX_CHECKED)
+#define MATRIX_CHECKED
+#endif
+
+/// A non-owning view of a row-major block of modular values. This is
+/// the fast path used by Gaussian elimination. Rows are reached through
+/// raw row pointers, there are no per-element index checks in release
+/// builds and ordinary conditions (no pivot in a column, an inconsistent
+/// system) are reported through return values rather than exceptions.
+///
+/// The view must be attached to a buffer of at least nrows * ncols values.
+struct matrix_view_t {
+    imod_t* _buf;       ///< first value of the first row
+    int _nRows;         ///< number of rows
+    int _nCols;         ///< number of columns
+
+    /// attach a view to an existing buffer
+    /// @param buf the row-major values
+    /// @param nrows number of rows
+    /// @param ncols number of columns
+    matrix_view_t(imod_t* buf, int nrows, int ncols)
+        : _buf(buf), _nRows(nrows), _nCols(ncols) {}
+
+    /// Returns a pointer to the first value of a row. The row index
+    /// is only validated in debug builds.
+    /// @param row row index
+    /// @returns pointer to _nCols consecutive values
+    imod_t* row(int row) const
+    {
+#ifdef MATRIX_CHECKED
+        check_row(row);
+#endif
+        return _buf + row * _nCols;
+    }
+
+    /// Throws if the row index is invalid (debug builds only)
+    /// @param row row index
+    void check_row(int row) const;
+
+    /// Swap two rows in place
+    /// @param row1 first row index
+    /// @param row2 second row index
+    void swap_rows(int row1, int row2);
+
+    /// Search column k, starting at row h, for a non-zero value
+    /// @param h first row to be examined
+    /// @param k column index
+    /// @returns the row index or -1 if there is no pivot in the column
+    int find_pivot_row(int h, int k) const;
+
+    /// Convert to upper echelon form with leading ones
+    void echelon();
+
+    /// Number of all zero rows at the bottom of an echelon form
+    int count_null_rows() const;
+
+    /// true if an echelon form has a zero on the diagonal
+    bool is_singular() const;
+
+    /// Back substitution for an augmented, non-singular echelon form.
+    /// See matrix_t::back_substitute()
+    void back_substitute();
+
+    /// Extract a particular solution of a singular but consistent
+    /// augmented echelon form. See matrix_t::solve_solvable_singular()
+    /// @param null_count number of all zero rows at the bottom
+    /// @param x destination for _nRows values
+    /// @returns false if the equations are inconsistent
+    bool solve_solvable_singular(int null_count, imod_t* x);
+
+    /// Solve the augmented system [M | B] in place. The buffer is
+    /// destroyed in the process.
+    /// @param x destination for _nRows values
+    /// @returns false if there is no solution
+    bool solve(imod_t* x);
+};
+
+/// A matrix with a fixed capacity of MaxRows x MaxCols values. The
+/// storage is a member array so the matrix lives entirely on the stack
+/// or inside the object that owns it and never touches the heap.
+/// Only the leading _nRows * _nCols values of the buffer are in use,
+/// packed in row-major order, so an augmented system can be built and
+/// solved in place through view().
+template <int MaxRows, int MaxCols>
+struct fixed_matrix_t {
+    static const int _maxRows = MaxRows;    ///< row capacity
+    static const int _maxCols = MaxCols;    ///< column capacity
+
+    int _nRows;                             ///< number of rows in use
+    int _nCols;                             ///< number of columns in use
+    imod_t _buf[MaxRows * MaxCols];         ///< fixed buffer holding the values
+
+    /// constructs an empty matrix
+    fixed_matrix_t() : _nRows(0), _nCols(0) {}
+
+    /// Sets the dimensions in use and sets the values in use to zero,
+    /// as a new matrix_t has, so nothing is left from an earlier use.
+    /// @param nrows number of rows, at most MaxRows
+    /// @param ncols number of columns, at most MaxCols
+    void resize(int nrows, int ncols)
+    {
+        if (nrows <= 0 || ncols <= 0 || nrows > MaxRows || ncols > MaxCols)
+            throw Exception("fixed_matrix_t::resize: invalid arguments");
+        _nRows = nrows;
+        _nCols = ncols;
+        for (int i = 0; i < nrows * ncols; i++)
+            _buf[i]._n = 0;
+    }
+
+    /// Returns a pointer to the first value of a row
+    /// @param row row index
+    imod_t* row(int row) { return view().row(row); }
+
+    /// Returns an unchecked view of the values in use
+    matrix_view_t view() { return matrix_view_t(_buf, _nRows, _nCols); }
+};
 
 /// This is the representation of a matrix of modular values
 struct matrix_t {
@@ -77,6 +194,9 @@ struct matrix_t {
     /// @returns a legal offset into buf
     int get_offset(int row, int col) const;
 
+    /// Returns an unchecked view of this matrix
+    matrix_view_t view() { return matrix_view_t(_buf.data(), _nRows, _nCols); }
+
     /// Find the column index of the first non-zero value in the specified row
     /// @param row row index
     /// @returns column index
@@ -114,15 +234,15 @@ struct matrix_t {
     /// reference on Gaussian elimination.
     /// @param h a magic index
     /// @param k another magic index
-    /// @return the index of the row to pivot
+    /// @return the index of the row to pivot or -1 if there is none
     int get_pivot_row(int h, int k) const;
 
     /// Pivots. This is a matrix thing. For details consult
     /// a reference on Gaussian elimination.
     /// @param h magic index
     /// @param k another magic index
-    /// @returns void
-    void pivot(int h, int k);
+    /// @returns false if column k has no pivot at or below row h
+    bool pivot(int h, int k);
 
     /// Convert this matrix into upper echelon form with
     /// ones on the diagonal (if possible)
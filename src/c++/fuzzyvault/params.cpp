@@ -22,12 +22,62 @@ params_t::params_t(int setSize,
                    int correctThreshold,
                    int corpusSize,
                    int prime,
-                   std::vector<uint8_t>* randomBytes) :
+                   std::vector<uint8_t>* randomBytes,
+                   int version,
+                   const kdf_params_t& kdf,
+                   const std::vector<uint8_t>* seed) :
     _setSize(setSize),
     _correctThreshold(correctThreshold),
     _corpusSize(corpusSize),
-    _prime(prime)
+    _prime(prime),
+    _version(version),
+    _kdf(kdf)
 {
+    crypto::rng_t rng(randomBytes, seed);
+    generate(rng);
+}
+
+params_t::params_t(int setSize,
+                   int correctThreshold,
+                   int corpusSize,
+                   int prime,
+                   crypto::rng_t& rng,
+                   int version,
+                   const kdf_params_t& kdf) :
+    _setSize(setSize),
+    _correctThreshold(correctThreshold),
+    _corpusSize(corpusSize),
+    _prime(prime),
+    _version(version),
+    _kdf(kdf)
+{
+    generate(rng);
+}
+
+params_t::params_t(int setSize,
+                   int correctThreshold,
+                   int corpusSize,
+                   int prime,
+                   const std::vector<int>& extractor,
+                   const std::vector<uint8_t>& salt,
+                   int version,
+                   const kdf_params_t& kdf) :
+    _setSize(setSize),
+    _correctThreshold(correctThreshold),
+    _corpusSize(corpusSize),
+    _prime(prime),
+    _extractor(extractor),
+    _salt(salt),
+    _version(version),
+    _kdf(kdf)
+{
+}
+
+void params_t::generate(crypto::rng_t& rng)
+{
+    if (_version != vault_version_1 && _version != vault_version_2)
+        throw Exception("params_t::params_t -- unsupported version");
+    _kdf.check();
     if (_setSize <= 0)
         throw Exception("params_t::params_t -- set_size <= 0");
     if (2 * _correctThreshold < _setSize)
@@ -36,9 +86,8 @@ params_t::params_t(int setSize,
         throw Exception("params_t::params_t -- set_size >= corpusSize");
     if (_correctThreshold > _setSize)
         throw Exception("params_t::params_t -- correctThreshold > set_size");
-    _salt.resize(32);
+    _salt.resize(params_salt_size);
 
-    crypto::rng_t rng(randomBytes);
     crypto::random_bytes(&rng, _salt);
     // std::vector<int> temp(_prime);
     // crypto::get_randomized_range(&rng, temp);
@@ -56,6 +105,8 @@ params_t::~params_t()
 
 void params_t::clear()
 {
+    _version = vault_version_1;
+    _kdf = kdf_params_t();
     _extractor.clear();
     _salt.clear();
 }
@@ -69,6 +120,7 @@ params_t::params_t(std::string json_string)
     const std::string extractor_s("extractor");
     const std::string prime_s("prime");
     const std::string salt_s("salt");
+    const std::string version_s("version");
 
     // These flags are set when the value is read
     bool b_setSize = false;
@@ -77,6 +129,8 @@ params_t::params_t(std::string json_string)
     bool b_prime = false;
     bool b_extractor = false;
     bool b_salt = false;
+    bool b_version = false;
+    unsigned kdf_seen = 0;
 
     struct json_value_s* root = json_parse(json_string.c_str(), json_string.length());
 
@@ -137,7 +191,14 @@ params_t::params_t(std::string json_string)
                 json_read_bytes(E, _salt);
                 b_salt = true;
             }
-            else
+            else if (version_s.compare(name) == 0)
+            {
+                if (b_version)
+                    throw Exception("params_t::params_t -- version set more than once");
+                json_read_int(E, _version);
+                b_version = true;
+            }
+            else if (!json_read_kdf(E, _kdf, kdf_seen))
             {
                 throw Exception("params_t::params_t -- bad key value");
             }
@@ -162,6 +223,9 @@ params_t::params_t(std::string json_string)
         throw Exception("params_t::params_t -- extractor not set");
     if (!b_salt)
         throw Exception("params_t::params_t -- salt not set");
+    if (_version != vault_version_1 && _version != vault_version_2)
+        throw Exception("params_t::params_t -- unsupported version");
+    _kdf.check();
 }
 
 std::ostream& operator<<(std::ostream& os, const params_t& params)
@@ -172,7 +236,12 @@ std::ostream& operator<<(std::ostream& os, const params_t& params)
         << "  \"correctThreshold\": " << std::dec << params._correctThreshold << "," << std::endl
         << "  \"prime\": " << std::dec << params._prime << "," << std::endl
         << "  \"extractor\": " << std::dec << params._extractor << "," << std::endl
-        << "  \"salt\": \"" << params._salt << "\"" << std::endl
+        << "  \"salt\": \"" << params._salt << "\"";
+    // version 1 predates the field and is written without it
+    if (params._version != vault_version_1)
+        os << "," << std::endl << "  \"version\": " << std::dec << params._version;
+    write_kdf_json(os, params._kdf);
+    os  << std::endl
         << "}";
     return os;
 }
@@ -13,7 +13,23 @@
 #include <ostream>
 #include <stdint.h>
 #include <vector>
+#include "kdf.h"
 
+namespace crypto {
+    struct rng_t;
+}
+
+/// The original format. The verification hash and the key material
+/// are derived with two separate scrypt calls.
+const int vault_version_1 = 1;
+
+/// One scrypt call derives twice the KDF length (128 bytes by default).
+/// The first half is the verification hash and the second half the key
+/// material.
+const int vault_version_2 = 2;
+
+/// bytes in the salt of generated parameters
+const size_t params_salt_size = 32;
 
 /// This structure contains the parameters of the key recovery
 /// scheme that is common to all secrets.
@@ -31,21 +47,57 @@ struct params_t {
 
     std::vector<int> _extractor; ///< A set of number used in key generation
     std::vector<uint8_t> _salt;  ///< a set of bits used for the has algorithm
+    int _version;            ///< vault_version_1 or vault_version_2
+    kdf_params_t _kdf;       ///< cost of the slow hash
 
     /// constructor for the paramters
     /// @param setSize number of words in a secret
     /// @param correctThreshold number of required matches to generate keys
     /// @param corpusSize number of available words to choose from
+    /// @param version the format of the secrets, see vault_version_1
+    /// @param kdf the cost of the slow hash
+    /// @param seed a seed to generate the random bytes from, in place of
+    ///     randomBytes, see crypto::rng_t
     /// @
     params_t(int setSize,
              int correctThreshold,
              int corpusSize,
              int prime,
-             std::vector<uint8_t>* randomBytes = 0
+             std::vector<uint8_t>* randomBytes = 0,
+             int version = vault_version_1,
+             const kdf_params_t& kdf = kdf_params_t(),
+             const std::vector<uint8_t>* seed = 0
+            );
+
+    /// Same as above with the random bytes drawn from a source the
+    /// caller owns, so one source can serve many parameters
+    /// @param rng the source of the salt and the extractor
+    params_t(int setSize,
+             int correctThreshold,
+             int corpusSize,
+             int prime,
+             crypto::rng_t& rng,
+             int version = vault_version_1,
+             const kdf_params_t& kdf = kdf_params_t()
+            );
+    /// Same as above with every field given, for example the copy of
+    /// the parameters a secret carries
+    params_t(int setSize,
+             int correctThreshold,
+             int corpusSize,
+             int prime,
+             const std::vector<int>& extractor,
+             const std::vector<uint8_t>& salt,
+             int version,
+             const kdf_params_t& kdf
             );
     params_t(std::string json_string);
     ~params_t();
     void clear();
+
+private:
+    /// validates the profile and draws the salt and the extractor
+    void generate(crypto::rng_t& rng);
 };
 
 std::ostream& operator<<(std::ostream& os, const params_t& params);
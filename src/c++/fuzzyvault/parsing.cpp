@@ -111,6 +111,13 @@ void json_read_int_value(const json_value_s* V, int& dst)
     dst = atoi(N->number);
 }
 
+void json_read_string(const json_object_element_s* E, std::string& dst)
+{
+    check_json_element(E, json_type_string);
+    const json_string_s& src = *((const json_string_s*)E->value->payload);
+    dst.assign(src.string, src.string_size);
+}
+
 void json_read_ints(const json_object_element_s* obj, std::vector<int>& dst)
 {
     check_json_element(obj, json_type_array);
@@ -13,6 +13,7 @@
 
 #include <stdint.h>
 #include <vector>
+#include <string>
 #include "json.h"
 
 /// Converts a JSON string of the form "HHHHHH" where H is an upper
@@ -53,6 +54,12 @@ void json_read_int(
 /// @returns void
 void json_read_int_value(const json_value_s* V, int& dst);
 
+/// Reads a json string
+/// @param E a json object element of type string
+/// @param dst the destination string
+/// @returns void
+void json_read_string(const json_object_element_s* E, std::string& dst);
+
 /// Reads an array of integers into a list
 /// @param E a json object element
 /// @param dst the list of integers to be filled
@@ -0,0 +1,211 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <algorithm>
+#include "pool.h"
+#include "exceptions.h"
+
+namespace {
+    /// more workers than this only add contention for the work we do
+    const int max_default_threads = 15;
+
+    int default_thread_count()
+    {
+        const int hardware = static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(0, std::min(hardware - 1, max_default_threads));
+    }
+
+    /// the pool installed on this thread, null for instance()
+    thread_local thread_pool_t* current_pool = 0;
+
+    /// the group of the task running on this thread, null outside tasks
+    thread_local task_group_t* current_group = 0;
+
+    /// true if group is ancestor or a group nested in it
+    bool nested_in(const task_group_t* group, const task_group_t* ancestor)
+    {
+        for (; group; group = group->_parent)
+            if (group == ancestor)
+                return true;
+        return false;
+    }
+}
+
+thread_pool_t::thread_pool_t(int count) : _stop(false)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    start(count);
+}
+
+thread_pool_t::~thread_pool_t()
+{
+    stop();
+}
+
+thread_pool_t& thread_pool_t::instance()
+{
+    static thread_pool_t pool(default_thread_count());
+    return pool;
+}
+
+thread_pool_t& thread_pool_t::current()
+{
+    return current_pool ? *current_pool : instance();
+}
+
+void thread_pool_t::set_thread_count(int count)
+{
+    if (count < 0)
+        throw Exception("thread_pool_t::set_thread_count -- count < 0");
+    stop();
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stop = false;
+    start(count);
+}
+
+int thread_pool_t::thread_count()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _workers.size();
+}
+
+void thread_pool_t::start(int count)
+{
+    for (int i = 0; i < count; i++)
+        _workers.push_back(std::thread(&thread_pool_t::work, this));
+}
+
+void thread_pool_t::stop()
+{
+    std::vector<std::thread> workers;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _stop = true;
+        workers.swap(_workers);
+    }
+    _cv.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void thread_pool_t::work()
+{
+    current_pool = this;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stop)
+    {
+        if (_queue.empty())
+        {
+            _cv.wait(lock);
+            continue;
+        }
+        task_t task = _queue.front();
+        _queue.pop_front();
+        run(task, lock);
+    }
+}
+
+bool thread_pool_t::take(const task_group_t* group, task_t& task)
+{
+    for (std::deque<task_t>::iterator it = _queue.begin(); it != _queue.end(); ++it)
+        if (nested_in(it->_group, group))
+        {
+            task = *it;
+            _queue.erase(it);
+            return true;
+        }
+    return false;
+}
+
+void thread_pool_t::run(task_t& task, std::unique_lock<std::mutex>& lock)
+{
+    lock.unlock();
+    std::exception_ptr error;
+    task_group_t* outer = current_group;
+    current_group = task._group;
+    try
+    {
+        task._fn();
+    }
+    catch(...)
+    {
+        error = std::current_exception();
+    }
+    current_group = outer;
+    lock.lock();
+    if (error && !task._group->_error)
+        task._group->_error = error;
+    task._group->_pending--;
+    _cv.notify_all();
+}
+
+task_group_t::task_group_t(thread_pool_t& pool) : _pool(pool), _parent(current_group), _pending(0)
+{
+}
+
+task_group_t::~task_group_t()
+{
+    try
+    {
+        wait();
+    }
+    catch(...)
+    {
+    }
+}
+
+void task_group_t::run(const std::function<void()>& fn)
+{
+    std::unique_lock<std::mutex> lock(_pool._mutex);
+    thread_pool_t::task_t task;
+    task._fn = fn;
+    task._group = this;
+    _pending++;
+    if (_pool._workers.empty())
+    {
+        _pool.run(task, lock);
+        return;
+    }
+    _pool._queue.push_back(task);
+    lock.unlock();
+    // a waiter that may not take the task must not swallow the wakeup
+    _pool._cv.notify_all();
+}
+
+void task_group_t::wait()
+{
+    std::unique_lock<std::mutex> lock(_pool._mutex);
+    while (_pending > 0)
+    {
+        thread_pool_t::task_t task;
+        if (!_pool.take(this, task))
+        {
+            _pool._cv.wait(lock);
+            continue;
+        }
+        _pool.run(task, lock);
+    }
+    if (_error)
+    {
+        std::exception_ptr error = _error;
+        _error = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+pool_scope_t::pool_scope_t(thread_pool_t& pool) : _previous(current_pool)
+{
+    current_pool = &pool;
+}
+
+pool_scope_t::~pool_scope_t()
+{
+    current_pool = _previous;
+}
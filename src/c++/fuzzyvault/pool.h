@@ -0,0 +1,162 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct task_group_t;
+
+/// A small process wide pool of worker threads used to run independent
+/// pieces of a single library call (for example two scrypt evaluations)
+/// at the same time.
+///
+/// Work is submitted through a task_group_t. A thread waiting on a group
+/// runs queued tasks of that group, or of groups nested in it, itself
+/// until the group is done, so a task may submit and wait on a nested
+/// group without deadlocking even if every worker is busy, and with no
+/// workers at all everything simply runs on the calling thread. A
+/// waiter never picks up the tasks of another call, so a short call
+/// waiting on its own hashes is not held up by a batch that shares
+/// the pool.
+///
+/// Besides the process wide pool a caller may make a pool of its own and
+/// install it on its thread with a pool_scope_t, see current().
+///
+/// All members are thread safe.
+struct thread_pool_t {
+    /// a queued piece of work
+    struct task_t {
+        std::function<void()> _fn;  ///< the work
+        task_group_t* _group;       ///< the group to report completion to
+    };
+
+    std::mutex _mutex;                  ///< guards everything below
+    std::condition_variable _cv;        ///< signalled on new tasks, completions and shutdown
+    std::deque<task_t> _queue;          ///< tasks not yet started
+    std::vector<std::thread> _workers;  ///< the worker threads
+    bool _stop;                         ///< tells the workers to exit
+
+    /// Returns the process wide pool. By default it has one worker less
+    /// than the number of hardware threads since the caller works too.
+    static thread_pool_t& instance();
+
+    /// Returns the pool work started on this thread should go to: the
+    /// pool of the innermost pool_scope_t on this thread, the pool this
+    /// thread is a worker of, or else instance().
+    static thread_pool_t& current();
+
+    /// starts a pool of its own with count workers
+    explicit thread_pool_t(int count);
+
+    /// joins the workers
+    ~thread_pool_t();
+
+    /// Changes the number of worker threads. Zero runs all work on the
+    /// calling thread. Must not be called from inside a task.
+    /// @param count the number of worker threads
+    /// @returns void
+    void set_thread_count(int count);
+
+    /// Returns the number of worker threads
+    int thread_count();
+
+private:
+    thread_pool_t(const thread_pool_t&);
+    thread_pool_t& operator=(const thread_pool_t&);
+
+    /// starts count workers, the lock must be held
+    void start(int count);
+
+    /// stops and joins all workers
+    void stop();
+
+    /// the loop run by every worker
+    void work();
+
+    /// Takes the first queued task of group or of a group nested in it
+    /// @param group the waiting group
+    /// @param task set to the task
+    /// @returns false if there is none
+    bool take(const task_group_t* group, task_t& task);
+
+    /// Runs one task outside the lock and reports its completion
+    /// @param task the task
+    /// @param lock held on entry and on return
+    void run(task_t& task, std::unique_lock<std::mutex>& lock);
+
+    friend struct task_group_t;
+};
+
+/// A set of tasks submitted to a thread_pool_t that are waited for
+/// together. If a task throws the first exception is rethrown by wait().
+///
+///     task_group_t group;
+///     group.run([&]() { get_hash(words, hash); });
+///     get_ek(words, ek);
+///     group.wait();
+struct task_group_t {
+    thread_pool_t& _pool;           ///< the pool the tasks run on
+    task_group_t* _parent;          ///< the group of the task that made this one, if any
+    int _pending;                   ///< tasks submitted and not yet finished
+    std::exception_ptr _error;      ///< the first exception thrown by a task
+
+    /// construct an empty group
+    /// @param pool the pool the tasks run on
+    task_group_t(thread_pool_t& pool = thread_pool_t::current());
+
+    /// waits for the tasks, any exception is dropped
+    ~task_group_t();
+
+    /// Submits a task. If the pool has no workers the task runs now.
+    /// @param fn the work
+    /// @returns void
+    void run(const std::function<void()>& fn);
+
+    /// Waits for all the tasks of the group, running its queued tasks
+    /// and those of nested groups while waiting, and rethrows the first exception thrown by any of them.
+    /// @returns void
+    void wait();
+
+private:
+    task_group_t(const task_group_t&);
+    task_group_t& operator=(const task_group_t&);
+};
+
+/// Makes a pool current on the calling thread for its lifetime, so the
+/// work of the library calls made meanwhile runs on it and the process
+/// wide pool is left alone.
+///
+///     thread_pool_t pool(count);
+///     pool_scope_t scope(pool);
+///     time_gen_keys(kdf, version, setSize);
+struct pool_scope_t {
+    thread_pool_t* _previous;   ///< the current pool before this scope
+
+    /// installs pool
+    /// @param pool the pool
+    explicit pool_scope_t(thread_pool_t& pool);
+
+    /// reinstalls the previous pool
+    ~pool_scope_t();
+
+private:
+    pool_scope_t(const pool_scope_t&);
+    pool_scope_t& operator=(const pool_scope_t&);
+};
+
+#endif
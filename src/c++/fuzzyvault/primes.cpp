@@ -0,0 +1,141 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <limits.h>
+#include "primes.h"
+#include "exceptions.h"
+
+namespace {
+    const int table_words = crypto::prime_table_limit / 64;
+
+    /// Bit n % 64 of word n / 64 is set if n is prime. Sieved when the
+    /// table is first used, which C++11 makes thread safe.
+    struct prime_table_t {
+        uint64_t _bits[table_words];
+
+        prime_table_t()
+        {
+            for (int i = 0; i < table_words; i++)
+                _bits[i] = ~uint64_t(0);
+            clear(0);
+            clear(1);
+            for (int p = 2; p * p < crypto::prime_table_limit; p++)
+                if (test(p))
+                    for (int m = p * p; m < crypto::prime_table_limit; m += p)
+                        clear(m);
+        }
+
+        bool test(int n) const
+        {
+            return (_bits[n >> 6] >> (n & 63)) & 1;
+        }
+
+        void clear(int n)
+        {
+            _bits[n >> 6] &= ~(uint64_t(1) << (n & 63));
+        }
+
+        static const prime_table_t& instance()
+        {
+            static const prime_table_t table;
+            return table;
+        }
+    };
+
+    uint64_t mul_mod(uint64_t a, uint64_t b, uint64_t m)
+    {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) % m);
+    }
+
+    uint64_t pow_mod(uint64_t base, uint64_t exponent, uint64_t m)
+    {
+        uint64_t result = 1;
+        base %= m;
+        for (; exponent; exponent >>= 1)
+        {
+            if (exponent & 1)
+                result = mul_mod(result, base, m);
+            base = mul_mod(base, base, m);
+        }
+        return result;
+    }
+}
+
+namespace crypto {
+
+    bool is_prime(const int n)
+    {
+        if (n < 2)
+            return false;
+        if (n < prime_table_limit)
+            return prime_table_t::instance().test(n);
+        return is_prime_u64(static_cast<uint64_t>(n));
+    }
+
+    bool is_prime_u64(uint64_t n)
+    {
+        if (n < 2)
+            return false;
+        const uint64_t small[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+        for (uint64_t p : small)
+        {
+            if (n % p == 0)
+                return n == p;
+        }
+        uint64_t d = n - 1;
+        int s = 0;
+        for (; (d & 1) == 0; d >>= 1)
+            s++;
+        // these bases decide every n below 2^64 (Jim Sinclair)
+        const uint64_t bases[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+        for (uint64_t a : bases)
+        {
+            a %= n;
+            if (a == 0)
+                continue;
+            uint64_t x = pow_mod(a, d, n);
+            if (x == 1 || x == n - 1)
+                continue;
+            bool composite = true;
+            for (int r = 1; r < s && composite; r++)
+            {
+                x = mul_mod(x, x, n);
+                composite = x != n - 1;
+            }
+            if (composite)
+                return false;
+        }
+        return true;
+    }
+
+    int first_prime_greater_than(int k)
+    {
+        if (k < 1)
+            throw Exception("first_prime_greater_than -- k < 1");
+        if (k == INT_MAX)
+            throw Exception("first_prime_greater_than -- no larger int is prime");
+        int n = k + 1;
+        if (n < prime_table_limit)
+        {
+            const prime_table_t& table = prime_table_t::instance();
+            int word = n >> 6;
+            uint64_t bits = table._bits[word] & (~uint64_t(0) << (n & 63));
+            while (bits == 0 && ++word < table_words)
+                bits = table._bits[word];
+            if (bits)
+                return (word << 6) + __builtin_ctzll(bits);
+            n = prime_table_limit;
+        }
+        // INT_MAX is prime, so this ends before n overflows
+        while (!is_prime(n))
+            n++;
+        return n;
+    }
+}
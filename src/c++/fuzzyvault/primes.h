@@ -0,0 +1,49 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _PRIMES_H_
+#define _PRIMES_H_
+
+#include <stdint.h>
+
+namespace crypto {
+
+    /// Numbers below this are looked up in a sieve table. It covers every
+    /// modulus imod_t accepts and the primes just above them.
+    const int prime_table_limit = 1 << 16;
+
+    /// tests the primality of an integers
+    ///
+    /// Below prime_table_limit this is a lookup in a table sieved once per
+    /// process, above it a Miller-Rabin test with a set of bases that is
+    /// exact for every 64 bit integer.
+    ///
+    /// @param n The integer to be tested
+    /// @returns true if n is prime else false
+    ///
+    /// Reference: https://en.wikipedia.org/wiki/Primality_test
+    bool is_prime(const int n);
+
+    /// Deterministic Miller-Rabin test of a 64 bit integer
+    /// @param n The integer to be tested
+    /// @returns true if n is prime else false
+    bool is_prime_u64(uint64_t n);
+
+    /// Returns the first prime strictly greater than
+    /// a specfied integer
+    ///
+    /// Within the table this scans the sieve a word at a time, beyond it
+    /// it tests the odd numbers in turn.
+    ///
+    /// @param k The exclusive lower bound on the prime
+    int first_prime_greater_than(int k);
+}
+
+#endif
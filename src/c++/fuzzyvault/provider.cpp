@@ -0,0 +1,192 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <openssl/crypto.h>
+#include <openssl/core_names.h>
+#include <openssl/err.h>
+#include <atomic>
+#include <mutex>
+#include "provider.h"
+#include "exceptions.h"
+
+namespace {
+    crypto::provider_t algorithms;
+
+    /// set once OpenSSL has started its cleanup at exit, after which the
+    /// contexts of threads that are still running must not be freed
+    std::atomic<bool> released(false);
+
+    void release_algorithms()
+    {
+        released = true;
+        EVP_MD_free(algorithms._sha512);
+        EVP_MAC_free(algorithms._hmac);
+        EVP_KDF_free(algorithms._pbkdf2);
+        EVP_KDF_free(algorithms._scrypt);
+        EVP_KDF_free(algorithms._argon2id);
+        EVP_CIPHER_free(algorithms._chacha20);
+    }
+
+    void fetch_algorithms()
+    {
+        algorithms._sha512 = EVP_MD_fetch(NULL, "SHA2-512", NULL);
+        algorithms._hmac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+        algorithms._pbkdf2 = EVP_KDF_fetch(NULL, "PBKDF2", NULL);
+        algorithms._scrypt = EVP_KDF_fetch(NULL, "SCRYPT", NULL);
+        algorithms._chacha20 = EVP_CIPHER_fetch(NULL, "ChaCha20", NULL);
+        // added in OpenSSL 3.2, a failed fetch leaves an error to clear
+        algorithms._argon2id = EVP_KDF_fetch(NULL, "ARGON2ID", NULL);
+        if (algorithms._argon2id == 0)
+            ERR_clear_error();
+        OPENSSL_atexit(release_algorithms);
+    }
+
+    /// Makes a KDF context, with the digest of its PRF set if given
+    EVP_KDF_CTX* new_kdf_context(EVP_KDF* kdf, const char* digest)
+    {
+        EVP_KDF_CTX* ctx = EVP_KDF_CTX_new(kdf);
+        if (ctx == 0 || digest == 0)
+            return ctx;
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, const_cast<char*>(digest), 0),
+            OSSL_PARAM_construct_end()
+        };
+        if (EVP_KDF_CTX_set_params(ctx, params) != 1)
+        {
+            EVP_KDF_CTX_free(ctx);
+            return 0;
+        }
+        return ctx;
+    }
+}
+
+namespace crypto {
+
+    const provider_t& provider_t::instance()
+    {
+        static std::once_flag once;
+        std::call_once(once, fetch_algorithms);
+        if (algorithms._sha512 == 0 || algorithms._hmac == 0 ||
+            algorithms._pbkdf2 == 0 || algorithms._scrypt == 0 || algorithms._chacha20 == 0)
+            throw Exception("provider_t -- an algorithm could not be fetched");
+        return algorithms;
+    }
+
+    thread_contexts_t::thread_contexts_t()
+        : _sha512(0), _hmac_sha3_512(0), _pbkdf2_sha256(0), _scrypt(0), _argon2id(0)
+    {
+        const provider_t& p = provider_t::instance();
+        _sha512 = EVP_MD_CTX_new();
+        if (_sha512 && EVP_DigestInit_ex2(_sha512, p._sha512, NULL) != 1)
+        {
+            EVP_MD_CTX_free(_sha512);
+            _sha512 = 0;
+        }
+        _hmac_sha3_512 = EVP_MAC_CTX_new(p._hmac);
+        if (_hmac_sha3_512)
+        {
+            OSSL_PARAM params[] = {
+                OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>("SHA3-512"), 0),
+                OSSL_PARAM_construct_end()
+            };
+            if (EVP_MAC_CTX_set_params(_hmac_sha3_512, params) != 1)
+            {
+                EVP_MAC_CTX_free(_hmac_sha3_512);
+                _hmac_sha3_512 = 0;
+            }
+        }
+        _pbkdf2_sha256 = new_kdf_context(p._pbkdf2, "SHA2-256");
+        _scrypt = new_kdf_context(p._scrypt, 0);
+        if (p._argon2id)
+            _argon2id = new_kdf_context(p._argon2id, 0);
+        if (_sha512 == 0 || _hmac_sha3_512 == 0 || _pbkdf2_sha256 == 0 || _scrypt == 0 ||
+            (p._argon2id && _argon2id == 0))
+        {
+            release();
+            throw Exception("thread_contexts_t -- could not make a context");
+        }
+    }
+
+    thread_contexts_t::~thread_contexts_t()
+    {
+        if (!released)
+            release();
+    }
+
+    void thread_contexts_t::release()
+    {
+        EVP_MD_CTX_free(_sha512);
+        EVP_MAC_CTX_free(_hmac_sha3_512);
+        EVP_KDF_CTX_free(_pbkdf2_sha256);
+        EVP_KDF_CTX_free(_scrypt);
+        EVP_KDF_CTX_free(_argon2id);
+        _sha512 = 0;
+        _hmac_sha3_512 = 0;
+        _pbkdf2_sha256 = 0;
+        _scrypt = 0;
+        _argon2id = 0;
+    }
+
+    thread_contexts_t& thread_contexts_t::instance()
+    {
+        static thread_local thread_contexts_t contexts;
+        return contexts;
+    }
+
+    void md_digest(EVP_MD_CTX* ctx,
+                   const unsigned char* data,
+                   size_t len,
+                   unsigned char* out
+                   )
+    {
+        const int ok = EVP_DigestInit_ex2(ctx, NULL, NULL) == 1 &&
+                       EVP_DigestUpdate(ctx, data, len) == 1 &&
+                       EVP_DigestFinal_ex(ctx, out, NULL) == 1;
+        if (!ok)
+            throw Exception("EVP_Digest");
+    }
+
+    void mac_compute(EVP_MAC_CTX* ctx,
+                     const unsigned char* key,
+                     size_t key_len,
+                     const unsigned char* data,
+                     size_t len,
+                     unsigned char* out,
+                     size_t out_len
+                     )
+    {
+        size_t written = 0;
+        const int ok = EVP_MAC_init(ctx, key, key_len, NULL) == 1 &&
+                       EVP_MAC_update(ctx, data, len) == 1 &&
+                       EVP_MAC_final(ctx, out, &written, out_len) == 1 &&
+                       written == out_len;
+        // rekeying with the same key drops the state of the message
+        EVP_MAC_init(ctx, NULL, 0, NULL);
+        if (!ok)
+            throw Exception("EVP_MAC");
+    }
+
+    void kdf_derive(EVP_KDF_CTX* ctx,
+                    unsigned char* out,
+                    size_t length,
+                    const OSSL_PARAM* params
+                    )
+    {
+        const int ok = EVP_KDF_derive(ctx, out, length, params);
+        // setting an empty password wipes and frees the previous one
+        OSSL_PARAM clear[] = {
+            OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_PASSWORD, const_cast<char*>(""), 0),
+            OSSL_PARAM_construct_end()
+        };
+        EVP_KDF_CTX_set_params(ctx, clear);
+        if (ok != 1)
+            throw Exception("EVP_KDF_derive");
+    }
+}
@@ -0,0 +1,107 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _PROVIDER_H_
+#define _PROVIDER_H_
+
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+
+namespace crypto {
+
+    /// The OpenSSL algorithms used by the library. Under OpenSSL 3 the
+    /// implicit lookups (EVP_sha3_512(), EVP_PKEY_CTX_new_id() and so on)
+    /// search the provider store on every call, so the algorithms are
+    /// fetched from the default provider once per process instead and
+    /// passed explicitly. They are freed by OpenSSL's cleanup at exit.
+    struct provider_t {
+        EVP_MD* _sha512;        ///< SHA2-512
+        EVP_MAC* _hmac;         ///< HMAC
+        EVP_KDF* _pbkdf2;       ///< PBKDF2
+        EVP_KDF* _scrypt;       ///< scrypt
+        EVP_KDF* _argon2id;     ///< Argon2id, null before OpenSSL 3.2
+        EVP_CIPHER* _chacha20;  ///< ChaCha20, the key stream of chacha_drbg_t
+
+        /// Returns the algorithms, fetching them on the first call. Thread
+        /// safe. Throws an Exception if one of them is not available,
+        /// except Argon2id which is optional.
+        static const provider_t& instance();
+    };
+
+    /// Contexts owned by one thread, made on first use with their
+    /// algorithm and parameters already set and reused by every later
+    /// call on that thread, which skips the lookups and allocations that
+    /// setting them up does. After a call the message state is dropped
+    /// from the MAC context and the password from the KDF contexts.
+    struct thread_contexts_t {
+        EVP_MD_CTX* _sha512;            ///< initialised with SHA2-512
+        EVP_MAC_CTX* _hmac_sha3_512;    ///< HMAC with SHA3-512
+        EVP_KDF_CTX* _pbkdf2_sha256;    ///< PBKDF2 with HMAC-SHA2-256
+        EVP_KDF_CTX* _scrypt;           ///< scrypt
+        EVP_KDF_CTX* _argon2id;         ///< Argon2id, null if not available
+
+        /// Returns the contexts of the calling thread
+        static thread_contexts_t& instance();
+
+        /// frees the contexts unless OpenSSL has already been cleaned up
+        ~thread_contexts_t();
+
+    private:
+        thread_contexts_t();
+        thread_contexts_t(const thread_contexts_t&);
+        thread_contexts_t& operator=(const thread_contexts_t&);
+
+        void release();
+    };
+
+    /// Hashes data with a reused digest context
+    /// @param ctx an initialised context of thread_contexts_t
+    /// @param data the bytes to hash
+    /// @param len bytes in data
+    /// @param out destination of the digest
+    /// @returns void
+    void md_digest(EVP_MD_CTX* ctx,
+                   const unsigned char* data,
+                   size_t len,
+                   unsigned char* out
+                   );
+
+    /// Computes a MAC with a reused MAC context
+    /// @param ctx a context of thread_contexts_t
+    /// @param key the key
+    /// @param key_len bytes in the key
+    /// @param data the message
+    /// @param len bytes in the message
+    /// @param out destination of the MAC
+    /// @param out_len the size of the MAC
+    /// @returns void
+    void mac_compute(EVP_MAC_CTX* ctx,
+                     const unsigned char* key,
+                     size_t key_len,
+                     const unsigned char* data,
+                     size_t len,
+                     unsigned char* out,
+                     size_t out_len
+                     );
+
+    /// Derives a key with a KDF context and clears the password from it
+    /// @param ctx a context of thread_contexts_t
+    /// @param out destination of the key
+    /// @param length the number of bytes to derive
+    /// @param params the password, salt and costs of this call
+    /// @returns void
+    void kdf_derive(EVP_KDF_CTX* ctx,
+                    unsigned char* out,
+                    size_t length,
+                    const OSSL_PARAM* params
+                    );
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <sstream>
+#include <vector>
+#include "registry.h"
+#include "binary.h"
+#include "crypto.h"
+#include "types.h"
+
+namespace {
+    /// bytes of the SHA-512 kept in an id
+    const size_t id_size = 32;
+}
+
+std::string params_id(const params_t& params)
+{
+    std::vector<uint8_t> encoding;
+    write_params_binary(params, encoding);
+    std::vector<uint8_t> hash;
+    crypto::sha512(encoding, hash);
+    std::stringstream id;
+    write_hex(id, hash.data(), id_size);
+    return id.str();
+}
+
+params_registry_t& params_registry_t::instance()
+{
+    static params_registry_t registry;
+    return registry;
+}
+
+std::string params_registry_t::add(const params_t& params)
+{
+    const std::string id = params_id(params);
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::shared_ptr<const params_t>& entry = _params[id];
+    if (!entry)
+        entry.reset(new params_t(params));
+    return id;
+}
+
+std::shared_ptr<const params_t> params_registry_t::find(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::map<std::string, std::shared_ptr<const params_t>>::const_iterator at = _params.find(id);
+    if (at == _params.end())
+        return std::shared_ptr<const params_t>();
+    return at->second;
+}
+
+bool params_registry_t::erase(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _params.erase(id) > 0;
+}
@@ -0,0 +1,56 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _REGISTRY_H_
+#define _REGISTRY_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "params.h"
+
+/// Returns the content hash of parameters, the first 32 bytes of the
+/// SHA-512 of their canonical encoding, see write_params_binary(), in
+/// upper case hex. Equal parameters have equal ids, whether they come
+/// from gen_params() or from a secret and however their JSON is laid
+/// out, and the ids do not change with the JSON writer.
+/// @param params the parameters
+/// @returns 64 hex characters
+std::string params_id(const params_t& params);
+
+/// The parameters secrets may refer to by id instead of carrying a copy,
+/// see write_compact_json(). One per process, all members thread safe.
+struct params_registry_t {
+    /// Returns the registry
+    static params_registry_t& instance();
+
+    /// Registers parameters. Registering equal parameters again returns
+    /// the same id and keeps the first copy.
+    /// @param params the parameters
+    /// @returns the id of the parameters, see params_id()
+    std::string add(const params_t& params);
+
+    /// Looks parameters up
+    /// @param id an id returned by add()
+    /// @returns the parameters, null if the id is not registered
+    std::shared_ptr<const params_t> find(const std::string& id);
+
+    /// Forgets parameters. Secrets already parsed keep their copy.
+    /// @param id an id returned by add()
+    /// @returns false if the id was not registered
+    bool erase(const std::string& id);
+
+private:
+    std::mutex _mutex;
+    std::map<std::string, std::shared_ptr<const params_t>> _params;
+};
+
+#endif
@@ -0,0 +1,356 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+#include <openssl/core_names.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include "scrypt.h"
+#include "crypto.h"
+#include "pool.h"
+#include "arena.h"
+#include "provider.h"
+#include "exceptions.h"
+
+/// Define SCRYPT_PORTABLE to build the portable Salsa20/8 kernel on
+/// hosts that have SSE2
+#if defined(__SSE2__) && !defined(SCRYPT_PORTABLE)
+#define SCRYPT_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    /// the V buffers of the lanes running at the same time share this budget
+    const size_t lane_memory_budget = size_t(1) << 30;
+
+    inline uint32_t le32dec(const uint8_t* p)
+    {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    inline void le32enc(uint8_t* p, uint32_t x)
+    {
+        p[0] = x & 0xff;
+        p[1] = (x >> 8) & 0xff;
+        p[2] = (x >> 16) & 0xff;
+        p[3] = (x >> 24) & 0xff;
+    }
+
+    // Inside ROMix every 64 byte Salsa20 block is kept with position i
+    // holding word i * 5 % 16. That puts the diagonals of the Salsa20 state
+    // in the four rows, which is what the SSE2 kernel needs, and costs
+    // nothing as the order only changes on the way in and out of ROMix.
+
+    /// Converts a block of B into the ROMix layout
+    void shuffle_in(const uint8_t* B, uint32_t* X, int r)
+    {
+        for (int k = 0; k < 2 * r; k++)
+            for (int i = 0; i < 16; i++)
+                X[k * 16 + i] = le32dec(B + (k * 16 + i * 5 % 16) * 4);
+    }
+
+    /// Converts a block in the ROMix layout back into B
+    void shuffle_out(const uint32_t* X, uint8_t* B, int r)
+    {
+        for (int k = 0; k < 2 * r; k++)
+            for (int i = 0; i < 16; i++)
+                le32enc(B + (k * 16 + i * 5 % 16) * 4, X[k * 16 + i]);
+    }
+
+#if defined(SCRYPT_SSE2)
+    inline __m128i rotate(__m128i x, int n)
+    {
+        return _mm_xor_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n));
+    }
+
+    /// Salsa20/8 of the block held in X0 .. X3 (one diagonal each)
+    inline void salsa20_8(__m128i& X0, __m128i& X1, __m128i& X2, __m128i& X3)
+    {
+        const __m128i B0 = X0;
+        const __m128i B1 = X1;
+        const __m128i B2 = X2;
+        const __m128i B3 = X3;
+        for (int i = 0; i < 8; i += 2)
+        {
+            // columns
+            X1 = _mm_xor_si128(X1, rotate(_mm_add_epi32(X0, X3), 7));
+            X2 = _mm_xor_si128(X2, rotate(_mm_add_epi32(X1, X0), 9));
+            X3 = _mm_xor_si128(X3, rotate(_mm_add_epi32(X2, X1), 13));
+            X0 = _mm_xor_si128(X0, rotate(_mm_add_epi32(X3, X2), 18));
+            X1 = _mm_shuffle_epi32(X1, 0x93);
+            X2 = _mm_shuffle_epi32(X2, 0x4E);
+            X3 = _mm_shuffle_epi32(X3, 0x39);
+            // rows
+            X3 = _mm_xor_si128(X3, rotate(_mm_add_epi32(X0, X1), 7));
+            X2 = _mm_xor_si128(X2, rotate(_mm_add_epi32(X3, X0), 9));
+            X1 = _mm_xor_si128(X1, rotate(_mm_add_epi32(X2, X3), 13));
+            X0 = _mm_xor_si128(X0, rotate(_mm_add_epi32(X1, X2), 18));
+            X1 = _mm_shuffle_epi32(X1, 0x39);
+            X2 = _mm_shuffle_epi32(X2, 0x4E);
+            X3 = _mm_shuffle_epi32(X3, 0x93);
+        }
+        X0 = _mm_add_epi32(X0, B0);
+        X1 = _mm_add_epi32(X1, B1);
+        X2 = _mm_add_epi32(X2, B2);
+        X3 = _mm_add_epi32(X3, B3);
+    }
+
+    inline __m128i load(const uint32_t* p)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+
+    inline void store(uint32_t* p, __m128i x)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x);
+    }
+
+    /// BlockMix of Bin xor-ed with Bxor (if not null) into Bout
+    void blockmix(const uint32_t* Bin, const uint32_t* Bxor, uint32_t* Bout, int r)
+    {
+        const int last = (2 * r - 1) * 16;
+        __m128i X0 = load(Bin + last);
+        __m128i X1 = load(Bin + last + 4);
+        __m128i X2 = load(Bin + last + 8);
+        __m128i X3 = load(Bin + last + 12);
+        if (Bxor)
+        {
+            X0 = _mm_xor_si128(X0, load(Bxor + last));
+            X1 = _mm_xor_si128(X1, load(Bxor + last + 4));
+            X2 = _mm_xor_si128(X2, load(Bxor + last + 8));
+            X3 = _mm_xor_si128(X3, load(Bxor + last + 12));
+        }
+        for (int i = 0; i < 2 * r; i++)
+        {
+            const uint32_t* in = Bin + i * 16;
+            X0 = _mm_xor_si128(X0, load(in));
+            X1 = _mm_xor_si128(X1, load(in + 4));
+            X2 = _mm_xor_si128(X2, load(in + 8));
+            X3 = _mm_xor_si128(X3, load(in + 12));
+            if (Bxor)
+            {
+                const uint32_t* x = Bxor + i * 16;
+                X0 = _mm_xor_si128(X0, load(x));
+                X1 = _mm_xor_si128(X1, load(x + 4));
+                X2 = _mm_xor_si128(X2, load(x + 8));
+                X3 = _mm_xor_si128(X3, load(x + 12));
+            }
+            salsa20_8(X0, X1, X2, X3);
+            // even blocks go to the first half, odd blocks to the second
+            uint32_t* out = Bout + ((i / 2) + (i & 1) * r) * 16;
+            store(out, X0);
+            store(out + 4, X1);
+            store(out + 8, X2);
+            store(out + 12, X3);
+        }
+    }
+#else
+    inline uint32_t rotate(uint32_t x, int n)
+    {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    /// Salsa20/8 of a block in the ROMix layout
+    void salsa20_8(uint32_t* block)
+    {
+        uint32_t x[16];
+        for (int i = 0; i < 16; i++)
+            x[i * 5 % 16] = block[i];
+        for (int i = 0; i < 8; i += 2)
+        {
+            // columns
+            x[ 4] ^= rotate(x[ 0] + x[12],  7);  x[ 8] ^= rotate(x[ 4] + x[ 0],  9);
+            x[12] ^= rotate(x[ 8] + x[ 4], 13);  x[ 0] ^= rotate(x[12] + x[ 8], 18);
+            x[ 9] ^= rotate(x[ 5] + x[ 1],  7);  x[13] ^= rotate(x[ 9] + x[ 5],  9);
+            x[ 1] ^= rotate(x[13] + x[ 9], 13);  x[ 5] ^= rotate(x[ 1] + x[13], 18);
+            x[14] ^= rotate(x[10] + x[ 6],  7);  x[ 2] ^= rotate(x[14] + x[10],  9);
+            x[ 6] ^= rotate(x[ 2] + x[14], 13);  x[10] ^= rotate(x[ 6] + x[ 2], 18);
+            x[ 3] ^= rotate(x[15] + x[11],  7);  x[ 7] ^= rotate(x[ 3] + x[15],  9);
+            x[11] ^= rotate(x[ 7] + x[ 3], 13);  x[15] ^= rotate(x[11] + x[ 7], 18);
+            // rows
+            x[ 1] ^= rotate(x[ 0] + x[ 3],  7);  x[ 2] ^= rotate(x[ 1] + x[ 0],  9);
+            x[ 3] ^= rotate(x[ 2] + x[ 1], 13);  x[ 0] ^= rotate(x[ 3] + x[ 2], 18);
+            x[ 6] ^= rotate(x[ 5] + x[ 4],  7);  x[ 7] ^= rotate(x[ 6] + x[ 5],  9);
+            x[ 4] ^= rotate(x[ 7] + x[ 6], 13);  x[ 5] ^= rotate(x[ 4] + x[ 7], 18);
+            x[11] ^= rotate(x[10] + x[ 9],  7);  x[ 8] ^= rotate(x[11] + x[10],  9);
+            x[ 9] ^= rotate(x[ 8] + x[11], 13);  x[10] ^= rotate(x[ 9] + x[ 8], 18);
+            x[12] ^= rotate(x[15] + x[14],  7);  x[13] ^= rotate(x[12] + x[15],  9);
+            x[14] ^= rotate(x[13] + x[12], 13);  x[15] ^= rotate(x[14] + x[13], 18);
+        }
+        for (int i = 0; i < 16; i++)
+            block[i] += x[i * 5 % 16];
+    }
+
+    /// BlockMix of Bin xor-ed with Bxor (if not null) into Bout
+    void blockmix(const uint32_t* Bin, const uint32_t* Bxor, uint32_t* Bout, int r)
+    {
+        const int last = (2 * r - 1) * 16;
+        uint32_t X[16];
+        for (int k = 0; k < 16; k++)
+            X[k] = Bin[last + k] ^ (Bxor ? Bxor[last + k] : 0);
+        for (int i = 0; i < 2 * r; i++)
+        {
+            for (int k = 0; k < 16; k++)
+                X[k] ^= Bin[i * 16 + k] ^ (Bxor ? Bxor[i * 16 + k] : 0);
+            salsa20_8(X);
+            // even blocks go to the first half, odd blocks to the second
+            std::copy(X, X + 16, Bout + ((i / 2) + (i & 1) * r) * 16);
+        }
+    }
+#endif
+
+    /// ROMix of one lane of B, in place
+    /// @param B the lane, 128 * r bytes
+    /// @param V scratch of N * 32 * r words
+    /// @param XY scratch of 64 * r words
+    void romix(uint8_t* B, int r, int N, uint32_t* V, uint32_t* XY)
+    {
+        const size_t words = 32 * static_cast<size_t>(r);
+        uint32_t* X = XY;
+        uint32_t* Y = XY + words;
+        shuffle_in(B, X, r);
+        for (int i = 0; i < N; i += 2)
+        {
+            std::copy(X, X + words, V + i * words);
+            blockmix(X, 0, Y, r);
+            std::copy(Y, Y + words, V + (i + 1) * words);
+            blockmix(Y, 0, X, r);
+        }
+        // Integerify reads the first word of the last 64 byte block,
+        // which the layout leaves in place. N < 2^32 so it is enough.
+        const uint32_t mask = N - 1;
+        for (int i = 0; i < N; i += 2)
+        {
+            uint32_t j = X[(2 * r - 1) * 16] & mask;
+            blockmix(X, V + j * words, Y, r);
+            j = Y[(2 * r - 1) * 16] & mask;
+            blockmix(Y, V + j * words, X, r);
+        }
+        shuffle_out(X, B, r);
+    }
+
+    void pbkdf2_sha256(const uint8_t* pass,
+                       size_t pass_len,
+                       const uint8_t* salt,
+                       size_t salt_len,
+                       uint8_t* out,
+                       size_t length
+                       )
+    {
+        int iterations = 1;
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_PASSWORD, const_cast<uint8_t*>(pass), pass_len),
+            OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT, const_cast<uint8_t*>(salt), salt_len),
+            OSSL_PARAM_construct_int(OSSL_KDF_PARAM_ITER, &iterations),
+            OSSL_PARAM_construct_end()
+        };
+        crypto::kdf_derive(crypto::thread_contexts_t::instance()._pbkdf2_sha256, out, length, params);
+    }
+}
+
+namespace crypto {
+
+    void scrypt_native(const uint8_t* pass,
+                       size_t pass_len,
+                       const uint8_t* salt,
+                       size_t salt_len,
+                       const kdf_params_t& kdf,
+                       uint8_t* out,
+                       size_t length
+                       )
+    {
+        kdf.check();
+        const int N = kdf._scryptN;
+        const int r = kdf._scryptR;
+        const int p = kdf._scryptP;
+        const size_t lane_bytes = 128 * static_cast<size_t>(r);
+        const size_t v_words = 32 * static_cast<size_t>(r) * N;
+
+        std::vector<uint8_t> B(lane_bytes * p);
+        pbkdf2_sha256(pass, pass_len, salt, salt_len, B.data(), B.size());
+
+        // One task per thread that can run, each runs every tasks-th
+        // lane with its own V, but never more V than the budget allows.
+        const size_t v_bytes = v_words * sizeof(uint32_t);
+        int tasks = std::min(p, thread_pool_t::current().thread_count() + 1);
+        tasks = std::max(1, std::min<int>(tasks, lane_memory_budget / v_bytes));
+        {
+            task_group_t group;
+            for (int t = 0; t < tasks; t++)
+            {
+                group.run([&, t]() {
+                    // V and XY come from the arena of the thread running
+                    // the task and are wiped when scratch goes out of scope
+                    const size_t xy_words = 64 * static_cast<size_t>(r);
+                    scratch_t scratch((v_words + xy_words) * sizeof(uint32_t));
+                    uint32_t* V = reinterpret_cast<uint32_t*>(scratch.data());
+                    uint32_t* XY = V + v_words;
+                    for (int lane = t; lane < p; lane += tasks)
+                        romix(B.data() + lane * lane_bytes, r, N, V, XY);
+                });
+            }
+            try
+            {
+                group.wait();
+            }
+            catch(...)
+            {
+                OPENSSL_cleanse(B.data(), B.size());
+                throw;
+            }
+        }
+
+        pbkdf2_sha256(pass, pass_len, B.data(), B.size(), out, length);
+        OPENSSL_cleanse(B.data(), B.size());
+    }
+
+    bool scrypt_native_verified()
+    {
+        static std::once_flag once;
+        static bool verified = false;
+        std::call_once(once, []() {
+            // small enough to be cheap, yet covering r > 1, p > 1,
+            // several lanes per task and outputs longer than one block
+            const int cases[][4] = {
+                // N, r, p, length
+                { 16, 1, 1, 64 },
+                { 32, 3, 5, 100 },
+                { 128, 8, 2, 128 }
+            };
+            const std::vector<uint8_t> pass = { 'p', 'a', 's', 's', 'w', 'o', 'r', 'd' };
+            const std::vector<uint8_t> salt = { 'N', 'a', 'C', 'l' };
+            try
+            {
+                bool ok = true;
+                for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+                {
+                    kdf_params_t kdf;
+                    kdf._scryptN = cases[i][0];
+                    kdf._scryptR = cases[i][1];
+                    kdf._scryptP = cases[i][2];
+                    std::vector<uint8_t> expected;
+                    scrypt_openssl(pass, salt, expected, cases[i][3], kdf);
+                    std::vector<uint8_t> actual(cases[i][3]);
+                    scrypt_native(pass.data(), pass.size(), salt.data(), salt.size(),
+                                  kdf, actual.data(), actual.size());
+                    ok = ok && actual == expected;
+                }
+                verified = ok;
+            }
+            catch(...)
+            {
+                verified = false;
+            }
+        });
+        return verified;
+    }
+}
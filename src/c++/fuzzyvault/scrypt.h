@@ -0,0 +1,51 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _SCRYPT_H_
+#define _SCRYPT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "kdf.h"
+
+namespace crypto {
+
+    /// scrypt as specified by RFC 7914, computed by the library.
+    ///
+    /// The p ROMix lanes are independent so they are spread over the
+    /// thread pool, each worker reusing one V buffer for all the lanes
+    /// it runs. V comes from the worker's scratch_arena_t. BlockMix uses
+    /// an SSE2 Salsa20/8 kernel where available and a portable one
+    /// otherwise. The output is identical to OpenSSL's SCRYPT KDF,
+    /// see scrypt_openssl().
+    ///
+    /// @param pass the password
+    /// @param pass_len bytes in the password
+    /// @param salt the salt
+    /// @param salt_len bytes in the salt
+    /// @param kdf the cost parameters N, r and p
+    /// @param out destination of the derived key
+    /// @param length the number of bytes to derive
+    /// @returns void
+    void scrypt_native(const uint8_t* pass,
+                       size_t pass_len,
+                       const uint8_t* salt,
+                       size_t salt_len,
+                       const kdf_params_t& kdf,
+                       uint8_t* out,
+                       size_t length
+                       );
+
+    /// Returns true if scrypt_native() agreed with OpenSSL on a set of
+    /// small known answers. The check runs once per process.
+    bool scrypt_native_verified();
+}
+
+#endif
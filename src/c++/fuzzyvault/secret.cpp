@@ -14,6 +14,7 @@
 #include <string>
 #include <algorithm>
 #include <set>
+#include <exception>
 #include "types.h"
 #include "params.h"
 #include "imod.h"
@@ -24,25 +25,57 @@
 #include "matrix.h"
 #include "utils.h"
 #include "berlwelch.h"
+#include "engines.h"
+#include "pool.h"
 #include "exceptions.h"
 #include "fuzzy.h"
 #include "parsing.h"
+#include "binary.h"
+#include "registry.h"
+
+namespace {
+    /// The decoder workspace used by recoveries that do not supply one
+    decoder_workspace_t& thread_workspace()
+    {
+        static thread_local decoder_workspace_t ws;
+        return ws;
+    }
+}
 
 void secret_t::get_keys(const std::vector<int> words, 
                         const int count, 
                         std::vector<std::vector<uint8_t>>& keys
                        ) const
 {
-    if (keys.size() != 0)
-        throw Exception("secret_t::get_keys -- keys is not empty");
     std::vector<uint8_t> ek;
     get_ek(words, ek);
+    get_keys_from_ek(ek, count, keys);
+}
+
+void secret_t::get_keys_from_ek(const std::vector<uint8_t>& ek,
+                                const int count,
+                                std::vector<std::vector<uint8_t>>& keys
+                               ) const
+{
+    if (keys.size() != 0)
+        throw Exception("secret_t::get_keys -- keys is not empty");
+    std::vector<uint8_t> all;
+    derive_keys(ek, count, all);
     keys.resize(count);
     for (int i = 0; i < count; i++)
-    {
-        std::vector<uint8_t>& key = keys[i];
-        get_key(ek, i, key);
-    }
+        keys[i].assign(all.begin() + i * 64, all.begin() + (i + 1) * 64);
+    std::fill(all.begin(), all.end(), 0);
+}
+
+void secret_t::derive_keys(const std::vector<uint8_t>& ek,
+                           const int count,
+                           std::vector<uint8_t>& keys
+                          ) const
+{
+    if (count < 0)
+        throw Exception("secret_t::derive_keys -- count < 0");
+    keys.resize(static_cast<size_t>(count) * 64);
+    crypto::hmac_keys(ek, count, keys.data());
 }
 
 secret_t::secret_t(const params_t& params,
@@ -50,7 +83,9 @@ secret_t::secret_t(const params_t& params,
                   ) : _setSize(params._setSize),
                       _correctThreshold(params._correctThreshold),
                       _corpusSize(params._corpusSize),
-                      _prime(params._prime)
+                      _prime(params._prime),
+                      _version(params._version),
+                      _kdf(params._kdf)
 {
     check_words(words, _setSize, _corpusSize);
     std::vector<int> sorted_words(words);
@@ -61,24 +96,68 @@ secret_t::secret_t(const params_t& params,
     get_hash(sorted_words, _hash);
 }
 
+secret_t::secret_t(const params_t& params,
+                   const std::vector<int>& sketch,
+                   const std::vector<uint8_t>& hash
+                  ) : _setSize(params._setSize),
+                      _correctThreshold(params._correctThreshold),
+                      _corpusSize(params._corpusSize),
+                      _prime(params._prime),
+                      _extractor(params._extractor),
+                      _salt(params._salt),
+                      _sketch(sketch),
+                      _hash(hash),
+                      _version(params._version),
+                      _kdf(params._kdf)
+{
+}
+
 void secret_t::get_scrypt(const std::string& prefix,
                           const std::vector<int>& words,
-                          std::vector<uint8_t>& out
+                          std::vector<uint8_t>& out,
+                          size_t length
                          ) const
 {
     out.clear();
     std::vector<uint8_t> pass(prefix.begin(), prefix.end());
     for (int word : words)
         pushback_int(word, pass);
-    crypto::scrypt(pass, _salt, out);
+    crypto::slow_hash(pass, _salt, out, length, _kdf);
 }
 
 void secret_t::get_hash(const std::vector<int>& words,
                         std::vector<uint8_t>& out
                        ) const
 {
+    if (_version == vault_version_2)
+    {
+        std::vector<uint8_t> ek;
+        get_hash_and_ek(words, out, ek);
+        std::fill(ek.begin(), ek.end(), 0);
+        return;
+    }
     std::string prefix = "original_words:";
-    return get_scrypt(prefix, words, out);
+    return get_scrypt(prefix, words, out, _kdf._length);
+}
+
+void secret_t::get_hash_and_ek(const std::vector<int>& words,
+                               std::vector<uint8_t>& hash,
+                               std::vector<uint8_t>& ek
+                              ) const
+{
+    if (_version != vault_version_2)
+    {
+        task_group_t group;
+        group.run([&]() { get_hash(words, hash); });
+        get_ek(words, ek);
+        group.wait();
+        return;
+    }
+    std::vector<uint8_t> both;
+    get_scrypt("original_words_and_key:", words, both, 2 * _kdf._length);
+    hash.assign(both.begin(), both.begin() + _kdf._length);
+    ek.assign(both.begin() + _kdf._length, both.end());
+    std::fill(both.begin(), both.end(), 0);
 }
 
 secret_t::~secret_t()
@@ -86,12 +165,20 @@ secret_t::~secret_t()
     clear();
 }
 
+params_t secret_t::params() const
+{
+    return params_t(_setSize, _correctThreshold, _corpusSize, _prime,
+                    _extractor, _salt, _version, _kdf);
+}
+
 void secret_t::clear()
 {
     _setSize = 0;
     _corpusSize = 0;
     _correctThreshold = 0;
     _prime = 0;
+    _version = vault_version_1;
+    _kdf = kdf_params_t();
     _extractor.clear();
     _salt.clear();
     _sketch.clear();
@@ -109,6 +196,11 @@ secret_t::secret_t(std::string json)
     const std::string salt_s("salt");
     const std::string sketch_s("sketch");
     const std::string hash_s("hash");
+    const std::string version_s("version");
+    const std::string paramsId_s("paramsId");
+    std::string paramsId;
+    bool version_seen = false;
+    unsigned kdf_seen = 0;
     struct json_value_s* root = json_parse(json.c_str(), json.length());
     if (root == 0)
         throw Exception("secret_t:secret_t -- json_parse failed");
@@ -139,6 +231,15 @@ secret_t::secret_t(std::string json)
                 json_read_ints(E, _sketch);
             else if (hash_s.compare(name) == 0)
                 json_read_bytes(E, _hash);
+            else if (version_s.compare(name) == 0)
+            {
+                json_read_int(E, _version);
+                version_seen = true;
+            }
+            else if (paramsId_s.compare(name) == 0)
+                json_read_string(E, paramsId);
+            else
+                json_read_kdf(E, _kdf, kdf_seen);
         }
     }
     catch (...)
@@ -147,25 +248,129 @@ secret_t::secret_t(std::string json)
         throw;
     }
     free(root);
+    if (!paramsId.empty())
+    {
+        if (_setSize != 0 || _corpusSize != 0 || _correctThreshold != 0 || _prime != 0 ||
+            !_extractor.empty() || !_salt.empty() || version_seen || kdf_seen != 0)
+            throw Exception("secret_t::secret_t -- paramsId and parameters both given");
+        std::shared_ptr<const params_t> params = params_registry_t::instance().find(paramsId);
+        if (!params)
+            throw Exception("secret_t::secret_t -- paramsId is not registered");
+        _setSize = params->_setSize;
+        _correctThreshold = params->_correctThreshold;
+        _corpusSize = params->_corpusSize;
+        _prime = params->_prime;
+        _extractor = params->_extractor;
+        _salt = params->_salt;
+        _version = params->_version;
+        _kdf = params->_kdf;
+    }
+    if (_version != vault_version_1 && _version != vault_version_2)
+        throw Exception("secret_t::secret_t -- unsupported version");
+    _kdf.check();
+}
+
+secret_t::secret_t(const fuzzy_vault::vault_secret_view_t& view)
+{
+    clear();
+    _setSize = view.setSize();
+    _correctThreshold = view.correctThreshold();
+    _corpusSize = view.corpusSize();
+    _prime = view.prime();
+    _version = view.version();
+    _kdf = read_binary_kdf(view);
+    _extractor.resize(_setSize);
+    for (int i = 0; i < _setSize; i++)
+        _extractor[i] = view.extractor(i);
+    _sketch.resize(view.sketchSize());
+    for (size_t i = 0; i < _sketch.size(); i++)
+        _sketch[i] = view.sketch(i);
+    _salt.assign(view.salt(), view.salt() + view.saltSize());
+    _hash.assign(view.hash(), view.hash() + view.hashSize());
+    if (_version != vault_version_1 && _version != vault_version_2)
+        throw Exception("secret_t::secret_t -- unsupported version");
+    _kdf.check();
 }
 
 void secret_t::recover(const std::vector<int>& recoveryWords, 
                        std::vector<int>& recoveredWords
                       ) const
 {
+    recover(recoveryWords, recoveredWords, thread_workspace());
+}
+
+void secret_t::recover(const std::vector<int>& recoveryWords, 
+                       std::vector<int>& recoveredWords,
+                       decoder_workspace_t& ws
+                      ) const
+{
+    std::exception_ptr decode_error = get_candidate(recoveryWords, recoveredWords, ws);
     std::vector<uint8_t> rhash;
-    std::vector<int> sorted_words(recoveryWords);
-    std::sort(sorted_words.begin(), sorted_words.end());
-    get_hash(sorted_words, rhash);
+    get_hash(recoveredWords, rhash);
     if (rhash == _hash)
-    {
-        recoveredWords.assign(sorted_words.begin(), sorted_words.end());
         return;
+    recoveredWords.clear();
+    if (decode_error)
+        std::rethrow_exception(decode_error);
+    throw fuzzy_vault::NoSolutionException();
+}
+
+void secret_t::recover_ek(const std::vector<int>& recoveryWords,
+                          std::vector<int>& recoveredWords,
+                          std::vector<uint8_t>& ek
+                         ) const
+{
+    std::exception_ptr decode_error = get_candidate(recoveryWords, recoveredWords, thread_workspace());
+    check_candidate(recoveredWords, decode_error, ek);
+}
+
+void secret_t::check_candidate(std::vector<int>& candidate,
+                               std::exception_ptr decode_error,
+                               std::vector<uint8_t>& ek
+                              ) const
+{
+    std::vector<uint8_t> rhash;
+    get_hash_and_ek(candidate, rhash, ek);
+    if (rhash == _hash)
+        return;
+    std::fill(ek.begin(), ek.end(), 0);
+    ek.clear();
+    candidate.clear();
+    if (decode_error)
+        std::rethrow_exception(decode_error);
+    throw fuzzy_vault::NoSolutionException();
+}
+
+std::exception_ptr secret_t::get_candidate(const std::vector<int>& recoveryWords,
+                                           std::vector<int>& candidate,
+                                           decoder_workspace_t& ws
+                                          ) const
+{
+    // Decode first and hash only the one candidate it produces. An exact
+    // match decodes to the sorted recovery words so it needs no hash of
+    // its own. Should the decoder fail the sorted recovery words are
+    // still tried, as they were before, and the decoder's exception is
+    // reported if they do not match either. NoSolutionException is not
+    // a std::exception so it is caught on its own.
+    std::exception_ptr error;
+    try
+    {
+        recover_words(recoveryWords, _sketch, errorThreshold(), candidate, ws);
     }
-    recover_words(recoveryWords, _sketch, errorThreshold(), recoveredWords);
-    get_hash(recoveredWords, rhash);
-    if (rhash != _hash)
-        throw fuzzy_vault::NoSolutionException();
+    catch(const fuzzy_vault::NoSolutionException&)
+    {
+        error = std::current_exception();
+    }
+    catch(const std::exception& e)
+    {
+        error = std::current_exception();
+    }
+    if (error)
+    {
+        candidate.assign(recoveryWords.begin(), recoveryWords.end());
+        std::sort(candidate.begin(), candidate.end());
+    }
+    return error;
 }
 
 void secret_t::get_ek(const std::vector<int>&words,
@@ -174,13 +379,26 @@ void secret_t::get_ek(const std::vector<int>&words,
 {
     std::vector<int> aList(words);
     std::sort(aList.begin(), aList.end());
+    if (_version == vault_version_2)
+    {
+        std::vector<uint8_t> hash;
+        get_hash_and_ek(aList, hash, out);
+        return;
+    }
+    // The product is reduced by the prime of the secret rather than by
+    // imod_t, so the key material can be derived without holding the
+    // global modulus
     const std::vector<int>& sList = _extractor;
-    imod_t e(1);
+    int e = 1 % _prime;
     for (int i = 0; i < _setSize; i++)
-        e = e * (imod_t(aList[i]) * imod_t(sList[i]));
+    {
+        const int a = (aList[i] % _prime + _prime) % _prime;
+        const int s = (sList[i] % _prime + _prime) % _prime;
+        e = imod_mul(e, imod_mul(a, s, _prime), _prime);
+    }
     std::vector<uint8_t> pass = { 'k', 'e', 'y', ':' };
-    pushback_int(e._n, pass);
-    crypto::scrypt(pass, _salt, out);
+    pushback_int(e, pass);
+    crypto::slow_hash(pass, _salt, out, _kdf._length, _kdf);
 }
 
 void secret_t::get_key(const std::vector<uint8_t>& ek,
@@ -246,19 +464,33 @@ void secret_t::recover_words(const std::vector<int>& words,
                              const int t,
                              std::vector<int>& out
                              )
+{
+    recover_words(words, sketch, t, out, thread_workspace());
+}
+
+void secret_t::recover_words(const std::vector<int>& words,
+                             const std::vector<int>& sketch,
+                             const int t,
+                             std::vector<int>& out,
+                             decoder_workspace_t& ws
+                             )
 {
     if (t % 2 != 0)
         throw Exception("recover_words -- t is not even");
     const int n = words.size();
+    ws.reserve(n);
     poly_t p_high = get_phigh(sketch, n);
     const std::vector<int>& a_coeffs = words;
-    std::vector<int> b_coeffs(n);
+    std::vector<int>& b_coeffs = ws._b_coeffs;
+    b_coeffs.resize(n);
     for (int i = 0; i < n; i++)
         b_coeffs[i] = p_high(a_coeffs[i]);
-    poly_t p_low = berlekamp_welch(a_coeffs, b_coeffs, n - t, t / 2);
+    const engine_choice_t engines = engine_registry_t::instance().select(n, t, imod_t::_modulus);
+    poly_t p_low = engines._decoder->decode(a_coeffs.data(), b_coeffs.data(), n, n - t, t / 2, ws);
     poly_t p_diff = p_high - p_low;
-    std::vector<root_t> roots;
-    p_diff.find_roots(roots);
+    std::vector<root_t>& roots = ws._roots;
+    roots.clear();
+    engines._roots->find_roots(p_diff, a_coeffs.data(), n, roots);
     if (roots.size() != static_cast<size_t>(n))
         throw fuzzy_vault::NoSolutionException();
     for (root_t r : roots)
@@ -283,6 +515,24 @@ std::ostream& operator<<(std::ostream& os,
         << "  \"extractor\": " << std::dec << secret._extractor << "," << std::endl
         << "  \"salt\": \"" << secret._salt << "\"," << std::endl
         << "  \"sketch\": " << std::dec << secret._sketch << "," << std::endl
+        << "  \"hash\": \"" << secret._hash << "\"";
+    // version 1 predates the field and is written without it
+    if (secret._version != vault_version_1)
+        os << "," << std::endl << "  \"version\": " << std::dec << secret._version;
+    write_kdf_json(os, secret._kdf);
+    os  << std::endl
+        << "}";
+    return os;
+}
+
+std::ostream& write_compact_json(std::ostream& os,
+                                 const secret_t& secret,
+                                 const std::string& id
+                                 )
+{
+    os  << "{" << std::endl
+        << "  \"paramsId\": \"" << id << "\"," << std::endl
+        << "  \"sketch\": " << std::dec << secret._sketch << "," << std::endl
         << "  \"hash\": \"" << secret._hash << "\"" << std::endl
         << "}";
     return os;
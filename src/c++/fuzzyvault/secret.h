@@ -11,11 +11,18 @@
 #ifndef _SECRET_H_
 #define _SECRET_H_
 
+#include <exception>
 #include <ostream>
 #include <stdint.h>
+#include <string>
 #include <vector>
 #include "poly.h"
 #include "params.h"
+#include "workspace.h"
+
+namespace fuzzy_vault {
+    class vault_secret_view_t;
+}
 
 /// The secret state used to recover keys. This information must
 /// be stored by the application and guarantee that it will
@@ -59,6 +66,8 @@ struct secret_t {
     std::vector<uint8_t> _hash; ///< a 512-bit hash of the original words.
                                 ///< This is used as a check of the recovery
                                 ///< and recovered words.
+    int _version;               ///< vault_version_1 or vault_version_2
+    kdf_params_t _kdf;          ///< cost of the slow hash
 
     /// Construct the secret using the specified parameters and words
     /// @param params The paramters of the scheme
@@ -67,13 +76,29 @@ struct secret_t {
              const std::vector<int> words
              );
     
+    /// Assemble a secret from its parts without deriving anything
+    /// @param params The parameters of the scheme
+    /// @param sketch errorThreshold() field elements, see gen_sketch()
+    /// @param hash the verification hash, see get_hash()
+    secret_t(const params_t& params,
+             const std::vector<int>& sketch,
+             const std::vector<uint8_t>& hash
+             );
+
     /// Reconstruct a secret from its JSON representation
     /// @param json A JSON string containing the representation of a secret
     secret_t(std::string json);
 
+    /// Reconstruct a secret from its binary representation
+    /// @param view the secret, see write_binary()
+    secret_t(const fuzzy_vault::vault_secret_view_t& view);
+
     /// destroys all resources
     ~secret_t();
 
+    /// Returns the parameters the secret was made with
+    params_t params() const;
+
     /// Clears all of the vector members
     void clear();
 
@@ -86,7 +111,8 @@ struct secret_t {
                   std::vector<uint8_t>& hash
                   ) const;
     
-    /// An internal function used at key recovery time.
+    /// An internal function used at key recovery time. It reduces by
+    /// _prime itself and does not need imod_t::initialize().
     /// @param words recovery words
     /// @param ek an array of bytes needed to generate all keys
     /// @returns void
@@ -94,17 +120,32 @@ struct secret_t {
                 std::vector<uint8_t>& ek
                 ) const;
 
+    /// Derives both the verification hash and the key material of a set
+    /// of words. Version 2 secrets take both from a single slow hash call.
+    /// For version 1 secrets these are the separate get_hash() and
+    /// get_ek() calls, run at the same time on the thread pool.
+    /// @param words sorted words
+    /// @param hash the destination of the hash
+    /// @param ek the destination of the key material
+    /// @returns void
+    void get_hash_and_ek(const std::vector<int>& words,
+                         std::vector<uint8_t>& hash,
+                         std::vector<uint8_t>& ek
+                         ) const;
+
     /// An internal function used to get the hash of a set of words
     /// @param prefix a string to be converted to bytes that serves
     ///     as the leading bytes of the thing to be hashed
     /// @param words These are the words to be hashed. The are 
     ///     converted to bytes and appended to the bytes initalized
     ///     with the prefix
-    /// @param scrypt This is the destination of the 512-bit hash
+    /// @param scrypt This is the destination of the hash
+    /// @param length the number of bytes to derive
     /// @returns void
     void get_scrypt(const std::string& prefix,
                     const std::vector<int>& words,
-                    std::vector<uint8_t>& scrypt
+                    std::vector<uint8_t>& scrypt,
+                    size_t length
                     ) const;
 
     /// An internal function to attempt to recover the original words
@@ -112,6 +153,10 @@ struct secret_t {
     /// recovering keys, checked against the hash of the original words
     /// if the hashes match then the keys can be recovered.
     ///
+    /// The words are decoded first and only the decoded candidate is
+    /// hashed, so a recovery costs one slow hash whether or not the
+    /// recovery words contain errors.
+    ///
     /// If it is not possible to recover the words a NoSolutionException
     /// is thrown.
     /// @param recoveryWords A set of words that is a guess at the original words
@@ -124,6 +169,45 @@ struct secret_t {
                  std::vector<int>& recoveredWords
                  ) const;
 
+    /// Same as recover() above but the decoder uses the scratch
+    /// buffers of the supplied workspace
+    /// @param recoveryWords A set of words that is a guess at the original words
+    /// @param recoveredWords destination for the recovered words
+    /// @param ws scratch space owned by the calling thread
+    /// @returns void
+    void recover(const std::vector<int>& recoveryWords,
+                 std::vector<int>& recoveredWords,
+                 decoder_workspace_t& ws
+                 ) const;
+
+    /// Same as recover() but also derives the key material of the
+    /// recovered words. The hash check and get_ek() are independent slow
+    /// hashes so they run at the same time on the thread pool. The key
+    /// material is discarded if the check fails.
+    /// @param recoveryWords A set of words that is a guess at the original words
+    /// @param recoveredWords destination for the recovered words
+    /// @param ek destination for the key material, see get_ek()
+    /// @returns void
+    void recover_ek(const std::vector<int>& recoveryWords,
+                    std::vector<int>& recoveredWords,
+                    std::vector<uint8_t>& ek
+                    ) const;
+
+    /// The second half of recover_ek(), for words decoded by other means
+    /// such as a batch_decoder_t: checks the candidate against the hash
+    /// and derives its key material. This is only slow hashes, so it
+    /// may run after imod_t::cleanup().
+    /// @param candidate the decoded words, see get_candidate(). Cleared
+    ///     if they do not match.
+    /// @param decode_error what the decoder threw, null if it decoded.
+    ///     Rethrown if the candidate does not match.
+    /// @param ek destination for the key material
+    /// @returns void
+    void check_candidate(std::vector<int>& candidate,
+                         std::exception_ptr decode_error,
+                         std::vector<uint8_t>& ek
+                         ) const;
+
     /// An internal function to generate a key. The original words
     /// have been successfully recovered.
     /// @param ek data used in the recovery of all keys
@@ -143,6 +227,25 @@ struct secret_t {
                   std::vector<std::vector<uint8_t>>& keys
                   ) const;
 
+    /// Same as get_keys() above starting from the key material
+    /// @param ek the key material of the original words, see get_ek()
+    /// @param count the number of unique keys to be generated
+    /// @param keys the list to into which the keys will be placed
+    void get_keys_from_ek(const std::vector<uint8_t>& ek,
+                          int count,
+                          std::vector<std::vector<uint8_t>>& keys
+                          ) const;
+
+    /// Same as get_keys_from_ek() but the keys are placed one after
+    /// another in a single buffer, 64 bytes each
+    /// @param ek the key material of the original words, see get_ek()
+    /// @param count the number of unique keys to be generated
+    /// @param keys destination of count * 64 bytes
+    void derive_keys(const std::vector<uint8_t>& ek,
+                     int count,
+                     std::vector<uint8_t>& keys
+                     ) const;
+
     /// Returns the errorThreshold which is the maximum symmetric difference
     /// between the original and recovery words allowed.
     int errorThreshold() const { return 2 * (_setSize - _correctThreshold); }
@@ -184,14 +287,50 @@ struct secret_t {
     /// @param errorThreshold The maximum allowed symmetric difference
     ///     allowed between the original and recovery words
     /// @param out  destination for the recovered words
+    ///
+    /// The decoder uses a workspace private to the calling thread.
     static void recover_words(const std::vector<int>& words,
                               const std::vector<int>& sketch,
                               const int errorThreshold,
                               std::vector<int>& out
                               );
+
+    /// Decodes the recovery words to the one candidate worth hashing
+    /// @param recoveryWords A set of words that is a guess at the original words
+    /// @param candidate destination for the candidate words. These are
+    ///     the sorted recovery words if decoding failed.
+    /// @param ws scratch space owned by the calling thread
+    /// @returns the exception thrown by the decoder, if any
+    std::exception_ptr get_candidate(const std::vector<int>& recoveryWords,
+                                     std::vector<int>& candidate,
+                                     decoder_workspace_t& ws
+                                     ) const;
+
+    /// Same as recover_words() above with caller supplied scratch space.
+    /// Once the workspace has grown to the set size and out has enough
+    /// capacity this does not allocate.
+    /// @param ws scratch space owned by the calling thread
+    static void recover_words(const std::vector<int>& words,
+                              const std::vector<int>& sketch,
+                              const int errorThreshold,
+                              std::vector<int>& out,
+                              decoder_workspace_t& ws
+                              );
 };
 
 /// Writes a JSON representation of a secret to a stream
 std::ostream& operator<<(std::ostream& os, const secret_t& secret);
 
+/// Writes the JSON of a secret that refers to its parameters by id
+/// instead of carrying them. It is read back by secret_t(std::string)
+/// while the parameters are in the params_registry_t.
+/// @param os the stream
+/// @param secret the secret
+/// @param id the id of the parameters of the secret, see params_id()
+/// @returns os
+std::ostream& write_compact_json(std::ostream& os,
+                                 const secret_t& secret,
+                                 const std::string& id
+                                 );
+
 #endif
\ No newline at end of file
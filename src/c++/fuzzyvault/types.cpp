@@ -35,13 +35,19 @@ std::ostream& operator<<(std::ostream& os, const std::vector<int>& xs)
 
 std::ostream& operator<<(std::ostream& os, const std::vector<uint8_t>& xs)
 {
-        for (uint8_t x : xs)
-            os 
-                << std::uppercase 
-                << std::hex
-                << std::setw(2)
-                << std::setfill('0') 
-                << (int)x;
+        return write_hex(os, xs.data(), xs.size());
+}
+
+std::ostream& write_hex(std::ostream& os, const uint8_t* data, size_t size)
+{
+        static const char digits[] = "0123456789ABCDEF";
+        std::string hex(2 * size, '0');
+        for (size_t i = 0; i < size; i++)
+        {
+            hex[2 * i] = digits[data[i] >> 4];
+            hex[2 * i + 1] = digits[data[i] & 0xf];
+        }
+        os << hex;
         return os;
 }
 
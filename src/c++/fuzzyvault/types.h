@@ -27,6 +27,13 @@ std::ostream& operator<<(std::ostream& os, const std::vector<int>& xs);
 /// for printing list of bytes in JSON format
 std::ostream& operator<<(std::ostream& os, const std::vector<uint8_t>& xs);
 
+/// Writes bytes as upper case hexadecimal, as operator<< above does
+/// @param os the stream
+/// @param data the bytes
+/// @param size the number of bytes
+/// @returns os
+std::ostream& write_hex(std::ostream& os, const uint8_t* data, size_t size);
+
 /// Reads the contents of a file into a string
 /// @param path the path to the text file
 /// @return a string containing the contents of the text file
@@ -36,17 +36,10 @@ std::stringstream utils::read_text(const std::string& path)
 }
 #endif
 
-std::vector<int> utils::parse_ints(const std::string& json)
-{
-    std::vector<int> output;
-    struct json_value_s* root = json_parse(json.c_str(), json.length());
-    if (root == 0)
-        throw Exception("utils::parse_ints -- json_parse failed");
-    try
+namespace {
+    /// Appends the integers of a JSON array to output
+    void read_ints(json_array_s* array, std::vector<int>& output)
     {
-        if (root->type != json_type_array)
-            throw Exception("utils::parse_ints -- not an array");
-        json_array_s* array = (json_array_s*)root->payload;
         if (array == 0)
             throw Exception("utils::parse_ints -- array == 0");
         for (json_array_element_s* E = array->start; E; E = E->next)
@@ -68,6 +61,53 @@ std::vector<int> utils::parse_ints(const std::string& json)
             output.push_back(n);
         }
     }
+}
+
+std::vector<int> utils::parse_ints(const std::string& json)
+{
+    std::vector<int> output;
+    struct json_value_s* root = json_parse(json.c_str(), json.length());
+    if (root == 0)
+        throw Exception("utils::parse_ints -- json_parse failed");
+    try
+    {
+        if (root->type != json_type_array)
+            throw Exception("utils::parse_ints -- not an array");
+        read_ints((json_array_s*)root->payload, output);
+    }
+    catch (...)
+    {
+        free(root);
+        throw;
+    }
+    free(root);
+
+    return output;
+}
+
+std::vector<std::vector<int>> utils::parse_int_lists(const std::string& json)
+{
+    std::vector<std::vector<int>> output;
+    struct json_value_s* root = json_parse(json.c_str(), json.length());
+    if (root == 0)
+        throw Exception("utils::parse_int_lists -- json_parse failed");
+    try
+    {
+        if (root->type != json_type_array)
+            throw Exception("utils::parse_int_lists -- not an array");
+        json_array_s* array = (json_array_s*)root->payload;
+        if (array == 0)
+            throw Exception("utils::parse_int_lists -- array == 0");
+        output.reserve(array->length);
+        for (json_array_element_s* E = array->start; E; E = E->next)
+        {
+            json_value_s* V = E->value;
+            if (V == 0 || V->type != json_type_array)
+                throw Exception("utils::parse_int_lists -- element is not an array");
+            output.push_back(std::vector<int>());
+            read_ints((json_array_s*)V->payload, output.back());
+        }
+    }
     catch (...)
     {
         free(root);
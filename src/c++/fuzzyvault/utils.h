@@ -52,6 +52,14 @@ std::stringstream read_text(const std::string& path);
  */
 std::vector<int> parse_ints(const std::string& input);
 
+/**
+ * Parse a JSON string assuming it is a list of lists of integers
+ * 
+ * @param input a JSON string
+ * @return a vector with the ints of each inner list
+ */
+std::vector<std::vector<int>> parse_int_lists(const std::string& input);
+
 /**
  * checks that the all of the integers are unique
  * 
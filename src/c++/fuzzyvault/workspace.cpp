@@ -0,0 +1,44 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#include <algorithm>
+#include "types.h"
+#include "workspace.h"
+#include "exceptions.h"
+
+decoder_workspace_t::decoder_workspace_t(int set_size) : _capacity(0)
+{
+    reserve(set_size);
+}
+
+decoder_workspace_t::~decoder_workspace_t()
+{
+    wipe();
+}
+
+void decoder_workspace_t::reserve(int set_size)
+{
+    if (set_size <= 0 || set_size > bw_max_set_size)
+        throw Exception("decoder_workspace_t::reserve -- set_size out of range");
+    if (set_size <= _capacity)
+        return;
+    _b_coeffs.reserve(set_size);
+    // a polynomial of degree set_size has at most set_size distinct roots
+    _roots.reserve(set_size + 1);
+    _capacity = set_size;
+}
+
+void decoder_workspace_t::wipe()
+{
+    std::fill(_b_coeffs.begin(), _b_coeffs.end(), 0);
+    _b_coeffs.clear();
+    _roots.clear();
+    std::fill(_matrix._buf, _matrix._buf + countof(_matrix._buf), imod_t());
+}
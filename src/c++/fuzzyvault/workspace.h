@@ -0,0 +1,50 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _WORKSPACE_H_
+#define _WORKSPACE_H_
+
+#include <vector>
+#include "poly.h"
+#include "berlwelch.h"
+
+/// Scratch space used by secret_t::recover_words(). A caller or a worker
+/// thread keeps one of these and passes it to every recovery. The buffers
+/// are sized for the largest set size seen so far, so once a workspace
+/// has been used for a given set size later recoveries of that size or
+/// smaller do not allocate.
+///
+/// A workspace is not thread safe. Use one per thread.
+struct decoder_workspace_t {
+    int _capacity;                  ///< largest set size the buffers can hold
+    std::vector<int> _b_coeffs;     ///< p_high evaluated at the recovery words
+    std::vector<root_t> _roots;     ///< roots of p_high - p_low
+    bw_matrix_t _matrix;            ///< the augmented Berlekamp-Welch system
+
+    /// construct a workspace
+    /// @param set_size the largest set size expected. The buffers are
+    ///     allocated up front for this size.
+    decoder_workspace_t(int set_size = bw_max_set_size);
+
+    /// wipes all buffers
+    ~decoder_workspace_t();
+
+    /// Makes sure the buffers can hold a recovery of the given set size.
+    /// This only allocates if set_size is larger than any seen before.
+    /// @param set_size number of recovery words
+    /// @returns void
+    void reserve(int set_size);
+
+    /// Zeros the contents of the buffers without releasing them
+    /// @returns void
+    void wipe();
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+/**
+ * Argon2id derivations running at the same time share the threads of
+ * OpenSSL's library context. Each must get its result, the same as the
+ * one computed on a single thread, however many run at once.
+ **/
+
+#include <string>
+#include <thread>
+#include <vector>
+#include "check.h"
+#include "crypto.h"
+#include "fuzzy.h"
+#include "pool.h"
+
+namespace {
+    /// derivations started at the same time, more than the threads of one
+    const int concurrent = 8;
+
+    void test_concurrent_derivations()
+    {
+        kdf_params_t kdf;
+        kdf._algorithm = kdf_argon2id;
+        kdf._argon2Memory = 256;
+        kdf._argon2Iterations = 2;
+        kdf._argon2Lanes = 4;
+        const std::string text("correct horse battery staple");
+        const std::vector<uint8_t> pass(text.begin(), text.end());
+        const std::vector<uint8_t> salt(32, 0x5a);
+
+        thread_pool_t::instance().set_thread_count(0);
+        std::vector<uint8_t> expected;
+        crypto::argon2id(pass, salt, expected, 64, kdf);
+        CHECK(expected.size() == 64);
+
+        thread_pool_t::instance().set_thread_count(3);
+        std::vector<std::vector<uint8_t>> outs(concurrent);
+        std::vector<int> failed(concurrent, 0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < concurrent; i++)
+            threads.push_back(std::thread([&, i]() {
+                try
+                {
+                    crypto::argon2id(pass, salt, outs[i], 64, kdf);
+                }
+                catch(...)
+                {
+                    failed[i] = 1;
+                }
+            }));
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+        for (int i = 0; i < concurrent; i++)
+        {
+            CHECK(failed[i] == 0);
+            CHECK(outs[i] == expected);
+        }
+    }
+
+    /// gen_keys() of a version 1 secret runs its two derivations at once
+    void test_concurrent_gen_keys()
+    {
+        fuzzy_vault::set_thread_count(3);
+        const std::string params = fuzzy_vault::gen_params(
+            "{ \"setSize\": 12, \"correctThreshold\": 9, \"corpusSize\": 7776,"
+            "  \"kdf\": \"argon2id\", \"argon2Memory\": 256, \"argon2Iterations\": 2 }");
+        const std::string words = "[1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12]";
+        const std::string secret = fuzzy_vault::gen_secret(params, words);
+        const std::string expected = fuzzy_vault::gen_keys(secret, words, 1);
+
+        std::vector<std::string> keys(concurrent);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < concurrent; i++)
+            threads.push_back(std::thread([&, i]() {
+                try
+                {
+                    keys[i] = fuzzy_vault::gen_keys(secret, words, 1);
+                }
+                catch(...)
+                {
+                }
+            }));
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+        for (int i = 0; i < concurrent; i++)
+            CHECK(keys[i] == expected);
+    }
+}
+
+int main()
+{
+    if (!crypto::argon2id_available())
+    {
+        std::cout << "argon2id needs OpenSSL 3.2 or later, skipped" << std::endl;
+        return skip_test;
+    }
+    test_concurrent_derivations();
+    test_concurrent_gen_keys();
+    return check_result();
+}
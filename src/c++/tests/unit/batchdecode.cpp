@@ -0,0 +1,188 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+/**
+ * The batch decoder must give every vault exactly what the scalar
+ * decoder gives it, and gen_keys_batch(), which decodes through it,
+ * exactly what gen_keys() gives each request.
+ **/
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "batchdecode.h"
+#include "crypto.h"
+#include "exceptions.h"
+#include "fuzzy.h"
+#include "imod.h"
+#include "secret.h"
+#include "types.h"
+
+namespace {
+    /// vaults decoded per profile, a few groups of lanes and a partial one
+    const int vaults = 45;
+
+    /// distinct random words below corpusSize
+    std::vector<int> random_words(std::mt19937& rng, int count, int corpusSize)
+    {
+        std::set<int> words;
+        while (words.size() < static_cast<size_t>(count))
+            words.insert(static_cast<int>(rng() % corpusSize));
+        std::vector<int> out(words.begin(), words.end());
+        std::shuffle(out.begin(), out.end(), rng);
+        return out;
+    }
+
+    /// The words with changes of them replaced by words not among them
+    std::vector<int> with_errors(std::mt19937& rng, const std::vector<int>& words, int changes, int corpusSize)
+    {
+        std::vector<int> out(words);
+        std::set<int> used(words.begin(), words.end());
+        for (int i = 0; i < changes; i++)
+        {
+            int word = static_cast<int>(rng() % corpusSize);
+            while (used.count(word))
+                word = static_cast<int>(rng() % corpusSize);
+            used.insert(word);
+            out[i] = word;
+        }
+        std::shuffle(out.begin(), out.end(), rng);
+        return out;
+    }
+
+    /// The status and words of secret_t::recover_words()
+    int decode_scalar(const std::vector<int>& words,
+                      const std::vector<int>& sketch,
+                      int errorThreshold,
+                      std::vector<int>& out
+                      )
+    {
+        try
+        {
+            secret_t::recover_words(words, sketch, errorThreshold, out);
+            return decode_ok;
+        }
+        catch(const fuzzy_vault::NoSolutionException&)
+        {
+            out.clear();
+            return decode_no_solution;
+        }
+        catch(const Exception&)
+        {
+            out.clear();
+            return decode_error;
+        }
+    }
+
+    void test_profile(std::mt19937& rng, int setSize, int correctThreshold, int corpusSize)
+    {
+        const int prime = crypto::first_prime_greater_than(corpusSize);
+        const int errorThreshold = 2 * (setSize - correctThreshold);
+        imod_t::initialize(prime);
+        std::vector<std::vector<int>> words;
+        std::vector<std::vector<int>> sketches;
+        for (int v = 0; v < vaults; v++)
+        {
+            std::vector<int> original = random_words(rng, setSize, corpusSize);
+            std::vector<int> sorted(original);
+            std::sort(sorted.begin(), sorted.end());
+            std::vector<int> sketch;
+            secret_t::gen_sketch(sorted, errorThreshold, sketch);
+            // from an exact match to a few words past what can be corrected
+            const int changes = v % (setSize - correctThreshold + 3);
+            words.push_back(with_errors(rng, original, changes, corpusSize));
+            sketches.push_back(sketch);
+        }
+        // a vault that does not fit the profile takes the scalar path
+        sketches.back().pop_back();
+
+        batch_decoder_t decoder(setSize, errorThreshold);
+        std::vector<std::vector<int>> out;
+        std::vector<int> status;
+        decoder.decode(words, sketches, out, status);
+        CHECK(out.size() == words.size());
+        CHECK(status.size() == words.size());
+        int decoded = 0;
+        for (size_t v = 0; v < words.size() && v < out.size() && v < status.size(); v++)
+        {
+            std::vector<int> expected;
+            const int expected_status = decode_scalar(words[v], sketches[v], errorThreshold, expected);
+            CHECK(status[v] == expected_status);
+            CHECK(out[v] == expected);
+            decoded += expected_status == decode_ok;
+        }
+        // both outcomes are covered
+        CHECK(decoded > 0);
+        CHECK(decoded < vaults);
+        imod_t::cleanup();
+    }
+
+    /// gen_keys_batch() against gen_keys() for a mix of requests
+    void test_gen_keys_batch(std::mt19937& rng)
+    {
+        const std::string params = fuzzy_vault::gen_params(
+            "{ \"setSize\": 12, \"correctThreshold\": 9, \"corpusSize\": 7776,"
+            "  \"scryptN\": 16, \"scryptP\": 1 }");
+        std::vector<fuzzy_vault::key_request_t> requests;
+        for (int r = 0; r < 20; r++)
+        {
+            const std::vector<int> original = random_words(rng, 12, 7776);
+            std::stringstream original_json;
+            original_json << original;
+            fuzzy_vault::key_request_t request;
+            request._secret = fuzzy_vault::gen_secret(params, original_json.str());
+            std::vector<int> recovery = with_errors(rng, original, r % 6, 7776);
+            // too few words is an error of its own request only
+            if (r == 7)
+                recovery.pop_back();
+            std::stringstream recovery_json;
+            recovery_json << recovery;
+            request._words = recovery_json.str();
+            request._keyCount = 1 + r % 3;
+            requests.push_back(request);
+        }
+
+        const std::vector<fuzzy_vault::key_result_t> results = fuzzy_vault::gen_keys_batch(requests);
+        CHECK(results.size() == requests.size());
+        for (size_t r = 0; r < requests.size() && r < results.size(); r++)
+        {
+            int status = fuzzy_vault::key_ok;
+            std::string keys;
+            try
+            {
+                keys = fuzzy_vault::gen_keys(requests[r]._secret, requests[r]._words, requests[r]._keyCount);
+            }
+            catch(const fuzzy_vault::NoSolutionException&)
+            {
+                status = fuzzy_vault::key_no_solution;
+            }
+            catch(const std::exception&)
+            {
+                status = fuzzy_vault::key_error;
+            }
+            CHECK(results[r]._status == status);
+            CHECK(results[r]._keys == keys);
+        }
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(20211);
+    test_profile(rng, 12, 9, 7776);
+    test_profile(rng, 16, 12, 2048);
+    test_profile(rng, 24, 17, 7776);
+    test_gen_keys_batch(rng);
+    return check_result();
+}
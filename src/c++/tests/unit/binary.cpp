@@ -0,0 +1,87 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+/**
+ * A secret survives JSON -> binary -> JSON unchanged, gives the same
+ * keys in either form, and a damaged buffer is refused.
+ **/
+
+#include <string>
+#include <vector>
+#include "check.h"
+#include "fuzzy.h"
+
+namespace {
+    bool throws(const std::vector<uint8_t>& data)
+    {
+        try
+        {
+            fuzzy_vault::vault_secret_view_t view(data.data(), data.size());
+            fuzzy_vault::vault_secret_t secret(view);
+        }
+        catch(const std::exception&)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    void test_profile(const std::string& params_input, const std::vector<int>& words)
+    {
+        std::string words_json = "[";
+        for (size_t i = 0; i < words.size(); i++)
+            words_json += (i ? ", " : "") + std::to_string(words[i]);
+        words_json += "]";
+        const std::string params = fuzzy_vault::gen_params(params_input);
+        const std::string json = fuzzy_vault::gen_secret(params, words_json);
+
+        const std::vector<uint8_t> data = fuzzy_vault::secret_to_binary(json);
+        CHECK(data.size() < json.size());
+        CHECK(fuzzy_vault::secret_to_json(data.data(), data.size()) == json);
+        const fuzzy_vault::vault_secret_t parsed(json);
+        CHECK(parsed.binary() == data);
+
+        // secrets laid end to end are read one at a time
+        std::vector<uint8_t> two(data);
+        two.insert(two.end(), data.begin(), data.end());
+        const fuzzy_vault::vault_secret_view_t view(two.data(), two.size());
+        CHECK(view.size() == data.size());
+        CHECK(view.setSize() == static_cast<int>(words.size()));
+        const fuzzy_vault::vault_secret_view_t second(two.data() + view.size(), two.size() - view.size());
+        CHECK(fuzzy_vault::vault_secret_t(second).json() == json);
+
+        const int key_count = 3;
+        std::vector<fuzzy_vault::vault_key_t> from_json(key_count);
+        std::vector<fuzzy_vault::vault_key_t> from_binary(key_count);
+        fuzzy_vault::gen_keys(parsed, words.data(), words.size(), from_json.data(), key_count);
+        fuzzy_vault::gen_keys(fuzzy_vault::vault_secret_t(view), words.data(), words.size(),
+                              from_binary.data(), key_count);
+        CHECK(from_json == from_binary);
+
+        // every truncation and a wrong magic
+        for (size_t size = 0; size < data.size(); size++)
+            CHECK(throws(std::vector<uint8_t>(data.begin(), data.begin() + size)));
+        std::vector<uint8_t> magic(data);
+        magic[0] ^= 0xff;
+        CHECK(throws(magic));
+        CHECK(!throws(data));
+    }
+}
+
+int main()
+{
+    test_profile("{ \"setSize\": 12, \"correctThreshold\": 9, \"corpusSize\": 7776,"
+                 "  \"scryptN\": 16, \"scryptP\": 1 }",
+                 { 5, 900, 17, 3021, 44, 7000, 612, 1999, 2500, 63, 4096, 7775 });
+    test_profile("{ \"setSize\": 16, \"correctThreshold\": 12, \"corpusSize\": 2048,"
+                 "  \"scryptN\": 16, \"scryptP\": 1 }",
+                 { 0, 1, 2, 3, 100, 200, 300, 400, 1000, 1100, 1200, 1300, 2044, 2045, 2046, 2047 });
+    return check_result();
+}
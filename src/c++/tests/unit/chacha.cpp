@@ -0,0 +1,100 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+/**
+ * The seeded generator hands out the ChaCha20 key stream of RFC 8439,
+ * the same bytes however the requests are sized.
+ **/
+
+#include <openssl/evp.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "drbg.h"
+
+namespace {
+    std::vector<uint8_t> from_hex(const std::string& hex)
+    {
+        std::vector<uint8_t> out;
+        for (size_t i = 0; i + 1 < hex.size(); i += 2)
+            out.push_back(static_cast<uint8_t>(std::stoi(hex.substr(i, 2), 0, 16)));
+        return out;
+    }
+
+    /// The key stream of a seed in requests of the given sizes
+    std::vector<uint8_t> stream(const uint8_t* seed, const std::vector<size_t>& sizes)
+    {
+        crypto::chacha_drbg_t drbg(seed);
+        std::vector<uint8_t> out;
+        for (size_t size : sizes)
+        {
+            std::vector<uint8_t> part(size);
+            drbg.generate(part.data(), part.size());
+            out.insert(out.end(), part.begin(), part.end());
+        }
+        return out;
+    }
+
+    /// The key stream of a seed from OpenSSL, zero counter and nonce
+    std::vector<uint8_t> openssl_stream(const uint8_t* seed, size_t size)
+    {
+        const uint8_t iv[16] = { 0 };
+        std::vector<uint8_t> zeros(size);
+        std::vector<uint8_t> out(size);
+        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+        int written = 0;
+        EVP_EncryptInit_ex(ctx, EVP_chacha20(), NULL, seed, iv);
+        EVP_EncryptUpdate(ctx, out.data(), &written, zeros.data(), static_cast<int>(size));
+        EVP_CIPHER_CTX_free(ctx);
+        return out;
+    }
+
+    /// RFC 8439 appendix A.1, test vectors 1 and 2
+    void test_known_answer()
+    {
+        const uint8_t seed[crypto::chacha_drbg_t::seed_size] = { 0 };
+        const std::vector<uint8_t> expected = from_hex(
+            "76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7"
+            "da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586"
+            "9f07e7be5551387a98ba977c732d080dcb0f29a048e3656912c6533e32ee7aed"
+            "29b721769ce64e43d57133b074d839d531ed1f28510afb45ace10a1f4b794d6f");
+        CHECK(stream(seed, { 128 }) == expected);
+        CHECK(stream(seed, { 64, 64 }) == expected);
+        CHECK(stream(seed, { 1, 63, 0, 3, 61 }) == expected);
+    }
+
+    /// requests of odd sizes across the refills of the generator
+    void test_request_sizes(std::mt19937& rng)
+    {
+        for (int run = 0; run < 20; run++)
+        {
+            uint8_t seed[crypto::chacha_drbg_t::seed_size];
+            for (uint8_t& b : seed)
+                b = static_cast<uint8_t>(rng());
+            std::vector<size_t> sizes;
+            size_t total = 0;
+            while (total < 2000)
+            {
+                sizes.push_back(rng() % 300);
+                total += sizes.back();
+            }
+            CHECK(stream(seed, sizes) == openssl_stream(seed, total));
+        }
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(8439);
+    test_known_answer();
+    test_request_sizes(rng);
+    return check_result();
+}
@@ -0,0 +1,42 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <iostream>
+
+/// Every unit test is a program of its own. It returns check_result()
+/// when done, or skip_test when what it covers is not in this build.
+const int skip_test = 77;
+
+/// the number of failed checks so far
+static int check_failures = 0;
+
+/// Reports a failed condition with its place and carries on, so one run
+/// shows every failure
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) \
+        { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            check_failures++; \
+        } \
+    } while (0)
+
+/// Returns the exit status of the test, reporting the failures
+inline int check_result()
+{
+    if (check_failures > 0)
+        std::cerr << check_failures << " checks failed" << std::endl;
+    return check_failures > 0 ? 1 : 0;
+}
+
+#endif
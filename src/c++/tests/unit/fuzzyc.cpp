@@ -0,0 +1,219 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+/**
+ * The C exports: the size convention, the status of every kind of
+ * failure, keys identical to those of the string API, and calls for
+ * different primes made from several threads at once.
+ **/
+
+#include <string.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "check.h"
+#include "fuzzy.h"
+#include "fuzzyc.h"
+
+namespace {
+    const int words[] = { 5, 900, 17, 3021, 44, 7000, 612, 1999, 2500, 63, 4096, 777 };
+    const size_t word_count = sizeof(words) / sizeof(words[0]);
+
+    std::string words_json(const int* w, size_t count)
+    {
+        std::stringstream out;
+        out << "[";
+        for (size_t i = 0; i < count; i++)
+            out << (i ? ", " : "") << w[i];
+        out << "]";
+        return out.str();
+    }
+
+    std::string input_json(int corpusSize, const std::string& extra)
+    {
+        std::stringstream out;
+        out << "{ \"setSize\": 12, \"correctThreshold\": 9, \"corpusSize\": " << corpusSize
+            << ", \"scryptN\": 16, \"scryptP\": 1" << extra << " }";
+        return out.str();
+    }
+
+    /// The keys of the string API, in the binary form of fuzzy_gen_keys()
+    std::vector<uint8_t> string_keys(const std::string& secret, const int* w, int key_count)
+    {
+        const std::string json = fuzzy_vault::gen_keys(secret, words_json(w, word_count), key_count);
+        std::vector<uint8_t> keys;
+        size_t at = 0;
+        while ((at = json.find('"', at)) != std::string::npos)
+        {
+            const size_t end = json.find('"', at + 1);
+            for (size_t i = at + 1; i + 1 < end; i += 2)
+                keys.push_back(static_cast<uint8_t>(std::stoi(json.substr(i, 2), 0, 16)));
+            at = end + 1;
+        }
+        return keys;
+    }
+
+    std::string gen_params(const std::string& input)
+    {
+        size_t size = 0;
+        if (fuzzy_gen_params(input.data(), input.size(), NULL, &size) != FUZZY_BUFFER_TOO_SMALL)
+            return std::string();
+        std::vector<char> out(size);
+        if (fuzzy_gen_params(input.data(), input.size(), out.data(), &size) != FUZZY_OK)
+            return std::string();
+        return out.data();
+    }
+
+    std::string gen_secret(const std::string& params, const int* w)
+    {
+        size_t size = 0;
+        if (fuzzy_gen_secret(params.data(), params.size(), w, word_count, NULL, &size) != FUZZY_BUFFER_TOO_SMALL)
+            return std::string();
+        std::vector<char> out(size);
+        if (fuzzy_gen_secret(params.data(), params.size(), w, word_count, out.data(), &size) != FUZZY_OK)
+            return std::string();
+        return out.data();
+    }
+
+    /// The size from a query fits every later result, and one byte less does not
+    void test_sizes(const std::string& extra)
+    {
+        const std::string input = input_json(7776, extra);
+        size_t params_size = 0;
+        CHECK(fuzzy_gen_params(input.data(), input.size(), NULL, &params_size) == FUZZY_BUFFER_TOO_SMALL);
+        CHECK(params_size > 0);
+        std::vector<char> params(params_size);
+        size_t size = params_size - 1;
+        CHECK(fuzzy_gen_params(input.data(), input.size(), params.data(), &size) == FUZZY_BUFFER_TOO_SMALL);
+        CHECK(size == params_size);
+
+        size_t secret_size = 0;
+        for (int run = 0; run < 20; run++)
+        {
+            size = params_size;
+            CHECK(fuzzy_gen_params(input.data(), input.size(), params.data(), &size) == FUZZY_OK);
+            CHECK(size == params_size);
+            CHECK(strlen(params.data()) < params_size);
+            const size_t params_len = strlen(params.data());
+
+            size_t needed = 0;
+            CHECK(fuzzy_gen_secret(params.data(), params_len, words, word_count, NULL, &needed) == FUZZY_BUFFER_TOO_SMALL);
+            CHECK(needed > 0);
+            if (secret_size == 0)
+                secret_size = needed;
+            CHECK(needed == secret_size);
+            std::vector<char> secret(needed);
+            CHECK(fuzzy_gen_secret(params.data(), params_len, words, word_count, secret.data(), &needed) == FUZZY_OK);
+            CHECK(strlen(secret.data()) < secret_size);
+        }
+    }
+
+    void test_status()
+    {
+        const std::string params = gen_params(input_json(7776, ""));
+        CHECK(!params.empty());
+        const std::string secret = gen_secret(params, words);
+        CHECK(!secret.empty());
+        size_t size = 0;
+        uint8_t keys[2 * FUZZY_KEY_SIZE];
+
+        // null pointers and negative counts
+        CHECK(fuzzy_gen_params(NULL, 0, NULL, &size) == FUZZY_INVALID_ARGUMENT);
+        CHECK(fuzzy_gen_params(params.data(), params.size(), NULL, NULL) == FUZZY_INVALID_ARGUMENT);
+        CHECK(fuzzy_gen_secret(params.data(), params.size(), NULL, word_count, NULL, &size) == FUZZY_INVALID_ARGUMENT);
+        CHECK(fuzzy_gen_keys(secret.data(), secret.size(), words, word_count, keys, -1) == FUZZY_INVALID_ARGUMENT);
+        CHECK(fuzzy_gen_keys(secret.data(), secret.size(), words, word_count, NULL, 1) == FUZZY_INVALID_ARGUMENT);
+        CHECK(fuzzy_gen_keys(NULL, 0, words, word_count, keys, 1) == FUZZY_INVALID_ARGUMENT);
+        CHECK(fuzzy_set_thread_count(-1) == FUZZY_INVALID_ARGUMENT);
+
+        // rejected input, each with its reason
+        const std::string bad = "{ \"setSize\": 12 ";
+        CHECK(fuzzy_gen_params(bad.data(), bad.size(), NULL, &size) == FUZZY_ERROR);
+        const std::string parse_error = fuzzy_last_error();
+        CHECK(!parse_error.empty());
+        CHECK(fuzzy_gen_keys(secret.data(), secret.size(), words, word_count - 1, keys, 1) == FUZZY_ERROR);
+        CHECK(strlen(fuzzy_last_error()) > 0);
+        CHECK(parse_error != fuzzy_last_error());
+        const std::string unused = input_json(7776, ", \"kdfLength\": 8");
+        std::vector<char> out(4096);
+        size = out.size();
+        CHECK(fuzzy_gen_params(unused.data(), unused.size(), out.data(), &size) == FUZZY_ERROR);
+        CHECK(strstr(fuzzy_last_error(), "kdfLength") != NULL);
+
+        // words too far from the original
+        int wrong[word_count];
+        for (size_t i = 0; i < word_count; i++)
+            wrong[i] = 5000 + static_cast<int>(i);
+        CHECK(fuzzy_gen_keys(secret.data(), secret.size(), wrong, word_count, keys, 1) == FUZZY_NO_SOLUTION);
+
+        // no keys is fine, and the keys are those of the string API
+        CHECK(fuzzy_gen_keys(secret.data(), secret.size(), words, word_count, NULL, 0) == FUZZY_OK);
+        int close[word_count];
+        memcpy(close, words, sizeof(close));
+        close[3] = 5555;
+        CHECK(fuzzy_gen_keys(secret.data(), secret.size(), close, word_count, keys, 2) == FUZZY_OK);
+        CHECK(std::vector<uint8_t>(keys, keys + sizeof(keys)) == string_keys(secret, words, 2));
+    }
+
+    /// calls for two primes at once share the global modulus in turn
+    void test_threads()
+    {
+        const int corpora[] = { 7776, 2048 };
+        std::vector<std::vector<int>> original(2, std::vector<int>(word_count));
+        std::vector<std::string> secrets;
+        std::vector<std::vector<uint8_t>> expected;
+        for (int which = 0; which < 2; which++)
+        {
+            for (size_t i = 0; i < word_count; i++)
+                original[which][i] = words[i] % corpora[which];
+            const std::string params = gen_params(input_json(corpora[which], ", \"version\": 2"));
+            secrets.push_back(gen_secret(params, original[which].data()));
+            CHECK(!secrets.back().empty());
+            expected.push_back(string_keys(secrets.back(), original[which].data(), 1));
+        }
+
+        fuzzy_set_thread_count(2);
+        const int threads = 8;
+        std::vector<int> failures(threads, 0);
+        std::vector<std::thread> running;
+        for (int t = 0; t < threads; t++)
+            running.push_back(std::thread([&, t]() {
+                const int which = t % 2;
+                const std::string input = input_json(corpora[which], "");
+                for (int run = 0; run < 20; run++)
+                {
+                    std::vector<int> w(original[which]);
+                    w[run % word_count] = 1500 + run;
+                    uint8_t key[FUZZY_KEY_SIZE];
+                    if (fuzzy_gen_keys(secrets[which].data(), secrets[which].size(), w.data(), word_count, key, 1) != FUZZY_OK ||
+                        std::vector<uint8_t>(key, key + FUZZY_KEY_SIZE) != expected[which])
+                        failures[t]++;
+                    if (gen_params(input).empty())
+                        failures[t]++;
+                }
+            }));
+        for (size_t t = 0; t < running.size(); t++)
+            running[t].join();
+        for (int t = 0; t < threads; t++)
+            CHECK(failures[t] == 0);
+    }
+}
+
+int main()
+{
+    test_sizes("");
+    test_sizes(", \"version\": 2");
+    test_sizes(", \"kdfLength\": 100");
+    test_sizes(", \"version\": 2, \"kdfLength\": 17");
+    test_status();
+    test_threads();
+    return check_result();
+}
@@ -0,0 +1,150 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+/**
+ * The multi buffer SHA3-512 and HMAC-SHA3-512 against known answers and
+ * against OpenSSL, on messages shorter and longer than the rate.
+ **/
+
+#include <openssl/evp.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "crypto.h"
+#include "keccak.h"
+#include "pool.h"
+#include "types.h"
+
+namespace {
+    std::vector<uint8_t> bytes(const std::string& text)
+    {
+        return std::vector<uint8_t>(text.begin(), text.end());
+    }
+
+    std::vector<uint8_t> from_hex(const std::string& hex)
+    {
+        std::vector<uint8_t> out;
+        for (size_t i = 0; i + 1 < hex.size(); i += 2)
+            out.push_back(static_cast<uint8_t>(std::stoi(hex.substr(i, 2), 0, 16)));
+        return out;
+    }
+
+    std::vector<uint8_t> openssl_sha3_512(const std::vector<uint8_t>& in)
+    {
+        std::vector<uint8_t> out(64);
+        unsigned int size = 0;
+        EVP_Digest(in.data(), in.size(), out.data(), &size, EVP_sha3_512(), NULL);
+        return out;
+    }
+
+    /// SHA3-512 of the same message in every lane
+    std::vector<uint8_t> lanes_sha3_512(const std::vector<uint8_t>& in)
+    {
+        std::vector<std::vector<uint8_t>> out(crypto::keccak_lanes, std::vector<uint8_t>(64));
+        const uint8_t* ins[crypto::keccak_lanes];
+        uint8_t* outs[crypto::keccak_lanes];
+        for (int i = 0; i < crypto::keccak_lanes; i++)
+        {
+            ins[i] = in.data();
+            outs[i] = out[i].data();
+        }
+        crypto::sha3_512_lanes(ins, in.size(), outs);
+        for (int i = 1; i < crypto::keccak_lanes; i++)
+            CHECK(out[i] == out[0]);
+        return out[0];
+    }
+
+    void test_known_answers()
+    {
+        const std::vector<uint8_t> abc = from_hex(
+            "b751850b1a57168a5693cd924b6b096e08f621827444f70d884f5d0240d2712e"
+            "10e116e9192af3c91a7ec57647e3934057340b4cf408d5a56592f8274eec53f0");
+        CHECK(lanes_sha3_512(bytes("abc")) == abc);
+        CHECK(openssl_sha3_512(bytes("abc")) == abc);
+
+        std::vector<uint8_t> mac;
+        crypto::hmac(bytes("key"), bytes("The quick brown fox jumps over the lazy dog"), mac);
+        CHECK(mac == from_hex(
+            "237a35049c40b3ef5ddd960b3dc893d8284953b9a4756611b1b61bffcf53edd9"
+            "79f93547db714b06ef0a692062c609b70208ab8d4a280ceee40ed8100f293063"));
+    }
+
+    /// different messages in the lanes, of every length up to a few blocks
+    void test_lanes(std::mt19937& rng)
+    {
+        for (size_t len = 0; len <= 4 * crypto::sha3_512_rate + 1; len++)
+        {
+            std::vector<std::vector<uint8_t>> in(crypto::keccak_lanes, std::vector<uint8_t>(len));
+            std::vector<std::vector<uint8_t>> out(crypto::keccak_lanes, std::vector<uint8_t>(64));
+            const uint8_t* ins[crypto::keccak_lanes];
+            uint8_t* outs[crypto::keccak_lanes];
+            for (int i = 0; i < crypto::keccak_lanes; i++)
+            {
+                for (uint8_t& b : in[i])
+                    b = static_cast<uint8_t>(rng());
+                ins[i] = in[i].data();
+                outs[i] = out[i].data();
+            }
+            crypto::sha3_512_lanes(ins, len, outs);
+            for (int i = 0; i < crypto::keccak_lanes; i++)
+                CHECK(out[i] == openssl_sha3_512(in[i]));
+        }
+    }
+
+    /// the keys of hmac_sha3_512_counters() and hmac_keys() are those of hmac()
+    void test_counters(std::mt19937& rng)
+    {
+        const int counts[] = { 1, 2, 3, 4, 5, 7, 8, 9, 33, 200 };
+        for (int count : counts)
+        {
+            std::vector<uint8_t> ek(1 + rng() % 160);
+            for (uint8_t& b : ek)
+                b = static_cast<uint8_t>(rng());
+            const int first = static_cast<int>(rng() % 1000);
+            std::vector<uint8_t> expected;
+            for (int i = 0; i < count; i++)
+            {
+                std::vector<uint8_t> key;
+                pushback_int(first + i, key);
+                std::vector<uint8_t> mac;
+                crypto::hmac(key, ek, mac);
+                expected.insert(expected.end(), mac.begin(), mac.end());
+            }
+            std::vector<uint8_t> out(static_cast<size_t>(count) * 64);
+            crypto::hmac_sha3_512_counters(ek.data(), ek.size(), first, count, out.data());
+            CHECK(out == expected);
+
+            std::vector<uint8_t> keys(static_cast<size_t>(count) * 64);
+            crypto::hmac_keys(ek, count, keys.data());
+            std::vector<uint8_t> from_zero(static_cast<size_t>(count) * 64);
+            crypto::hmac_sha3_512_counters(ek.data(), ek.size(), 0, count, from_zero.data());
+            CHECK(keys == from_zero);
+            std::vector<uint8_t> first_key;
+            std::vector<uint8_t> zero;
+            pushback_int(0, zero);
+            crypto::hmac(zero, ek, first_key);
+            CHECK(std::vector<uint8_t>(keys.begin(), keys.begin() + 64) == first_key);
+        }
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(3512);
+    test_known_answers();
+    test_lanes(rng);
+    thread_pool_t::instance().set_thread_count(0);
+    test_counters(rng);
+    // large counts are split over the workers
+    thread_pool_t::instance().set_thread_count(3);
+    test_counters(rng);
+    return check_result();
+}
@@ -0,0 +1,124 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+/**
+ * The table of inverses of every prime modulus imod_t accepts, up to
+ * 0x8000, against the definition, and against an exhaustive search
+ * for the smaller primes. Tables dropped from the cache are made again
+ * and calls for another modulus are let in in turn.
+ **/
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "check.h"
+#include "imod.h"
+#include "primes.h"
+
+namespace {
+    /// primes up to this are also checked by searching every candidate
+    const int searched = 1 << 10;
+
+    void test_prime(int p)
+    {
+        std::vector<int> inv;
+        imod_inverses(p, inv);
+        CHECK(inv.size() == static_cast<size_t>(p));
+        if (inv.size() != static_cast<size_t>(p))
+            return;
+        CHECK(inv[0] == 0);
+        for (int i = 1; i < p; i++)
+        {
+            CHECK(0 < inv[i] && inv[i] < p);
+            CHECK(inv[i] * i % p == 1);
+        }
+        if (p > searched)
+            return;
+        for (int i = 1; i < p; i++)
+        {
+            int found = 0;
+            for (int j = 1; j < p && !found; j++)
+                if (i * j % p == 1)
+                    found = j;
+            CHECK(inv[i] == found);
+        }
+    }
+
+    /// inv() reads the table initialize() installs
+    void test_inv(int p)
+    {
+        imod_t::initialize(p);
+        for (int i = 1; i < p; i++)
+            CHECK(imod_t(i).inv() * imod_t(i) == 1);
+        imod_t::cleanup();
+    }
+
+    /// more moduli than are cached, in turn and again, still invert
+    void test_many_moduli()
+    {
+        std::vector<int> primes;
+        for (int p = 0x8000; primes.size() < 40; p--)
+            if (crypto::is_prime(p))
+                primes.push_back(p);
+        for (int round = 0; round < 2; round++)
+            for (int p : primes)
+            {
+                imod_t::initialize(p);
+                for (int i = 1; i < p; i += 97)
+                    CHECK(imod_t(i).inv() * imod_t(i) == 1);
+                imod_t::cleanup();
+            }
+    }
+
+    /// A call for the held modulus that arrives after a call for another
+    /// one waits behind it instead of joining the holders
+    void test_turns()
+    {
+        std::mutex mutex;
+        std::vector<int> entered;
+        auto enter = [&](int p) {
+            imod_t::initialize(p);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                entered.push_back(p);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            imod_t::cleanup();
+        };
+        auto pause = []() { std::this_thread::sleep_for(std::chrono::milliseconds(100)); };
+
+        imod_t::initialize(7789);
+        std::thread other(enter, 101);
+        pause();
+        std::thread same(enter, 7789);
+        pause();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            CHECK(entered.empty());
+        }
+        imod_t::cleanup();
+        other.join();
+        same.join();
+        CHECK(entered == std::vector<int>({ 101, 7789 }));
+    }
+}
+
+int main()
+{
+    for (int p = 2; p <= 0x8000; p++)
+        if (crypto::is_prime(p))
+            test_prime(p);
+    test_inv(7789);
+    test_inv(32749);
+    test_many_moduli();
+    test_turns();
+    return check_result();
+}
@@ -0,0 +1,108 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+/**
+ * A thread waiting on a task group runs the queued tasks of its own
+ * group and of the groups nested in it, never those of another call.
+ **/
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "check.h"
+#include "pool.h"
+
+namespace {
+    /// spins until flag is set
+    void await(const std::atomic<bool>& flag)
+    {
+        while (!flag.load())
+            std::this_thread::yield();
+    }
+
+    /// the task of another call queued behind a busy worker is left to it
+    void test_other_calls()
+    {
+        thread_pool_t pool(1);
+        std::atomic<bool> started(false);
+        std::atomic<bool> release(false);
+        std::atomic<bool> queued(false);
+        const std::thread::id caller = std::this_thread::get_id();
+        std::atomic<bool> other_ran(false);
+        std::atomic<bool> ran_here(false);
+        std::thread other([&]() {
+            task_group_t group(pool);
+            group.run([&]() { started = true; await(release); });
+            await(started);
+            group.run([&]() {
+                ran_here = std::this_thread::get_id() == caller;
+                other_ran = true;
+            });
+            queued = true;
+            group.wait();
+        });
+        await(queued);
+
+        // the one worker is busy, so this group's task runs here
+        std::thread::id mine;
+        task_group_t group(pool);
+        group.run([&]() {
+            mine = std::this_thread::get_id();
+            // and a nested group is still helped by its waiter
+            task_group_t nested(pool);
+            std::thread::id inner;
+            nested.run([&]() { inner = std::this_thread::get_id(); });
+            nested.wait();
+            CHECK(inner == std::this_thread::get_id());
+        });
+        group.wait();
+        CHECK(mine == caller);
+        CHECK(!ran_here);
+
+        release = true;
+        other.join();
+        CHECK(other_ran);
+        CHECK(!ran_here);
+    }
+
+    /// exceptions still reach the waiter of their own group
+    void test_errors()
+    {
+        thread_pool_t pool(2);
+        task_group_t group(pool);
+        std::atomic<int> done(0);
+        for (int i = 0; i < 20; i++)
+            group.run([&, i]() {
+                task_group_t nested(pool);
+                nested.run([&]() { done++; });
+                nested.wait();
+                if (i == 7)
+                    throw 7;
+            });
+        bool thrown = false;
+        try
+        {
+            group.wait();
+        }
+        catch(int)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+        CHECK(done == 20);
+    }
+}
+
+int main()
+{
+    test_other_calls();
+    test_errors();
+    return check_result();
+}
@@ -0,0 +1,92 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+/**
+ * The sieve table and Miller-Rabin against trial division, on both
+ * sides of prime_table_limit, and on the pseudoprimes that fool weaker
+ * sets of bases.
+ **/
+
+#include <random>
+#include "check.h"
+#include "primes.h"
+
+namespace {
+    bool trial_division(uint64_t n)
+    {
+        if (n < 2)
+            return false;
+        for (uint64_t d = 2; d * d <= n; d++)
+            if (n % d == 0)
+                return false;
+        return true;
+    }
+
+    /// every n below twice the table limit, and the search for the next prime
+    void test_small()
+    {
+        const int limit = 2 * crypto::prime_table_limit;
+        int next = 2;
+        for (int n = -2; n < limit; n++)
+        {
+            const bool prime = trial_division(n < 0 ? 0 : n);
+            CHECK(crypto::is_prime(n) == prime);
+            CHECK(crypto::is_prime_u64(n < 0 ? 0 : n) == prime);
+            if (n >= next)
+            {
+                next = n + 1;
+                while (!trial_division(next))
+                    next++;
+            }
+            if (n >= 1)
+                CHECK(crypto::first_prime_greater_than(n) == next);
+        }
+    }
+
+    /// random 31 bit integers, most above the table
+    void test_random(std::mt19937& rng)
+    {
+        for (int run = 0; run < 4000; run++)
+        {
+            const int n = static_cast<int>(rng() & 0x7fffffff) | (run & 1);
+            CHECK(crypto::is_prime(n) == trial_division(n));
+            CHECK(crypto::is_prime_u64(n) == trial_division(n));
+        }
+    }
+
+    void test_pseudoprimes()
+    {
+        // Carmichael numbers and strong pseudoprimes to small bases
+        const uint64_t composites[] = {
+            561, 1105, 1729, 2047, 1373653, 25326001, 3215031751ULL,
+            2152302898747ULL, 3474749660383ULL, 341550071728321ULL,
+            3825123056546413051ULL,
+            4294967291ULL * 4294967279ULL, 0xffffffffffffffffULL
+        };
+        for (uint64_t n : composites)
+            CHECK(!crypto::is_prime_u64(n));
+        CHECK(!crypto::is_prime(2147483647 - 2));
+        CHECK(crypto::is_prime(2147483647));
+        CHECK(crypto::is_prime_u64(2305843009213693951ULL));
+        CHECK(crypto::is_prime_u64(18446744073709551557ULL));
+        // the odd numbers above the largest 64 bit prime
+        for (uint64_t n = 18446744073709551559ULL; n > 18446744073709551557ULL; n += 2)
+            CHECK(!crypto::is_prime_u64(n));
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(65537);
+    test_small();
+    test_random(rng);
+    test_pseudoprimes();
+    return check_result();
+}
@@ -0,0 +1,102 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+/**
+ * When the decoder fails, NoSolutionException included, recovery still
+ * tries the sorted recovery words and reports the decoder's exception
+ * only if they do not match either.
+ **/
+
+#include <algorithm>
+#include <exception>
+#include <vector>
+#include "check.h"
+#include "crypto.h"
+#include "fuzzy.h"
+#include "imod.h"
+#include "params.h"
+#include "secret.h"
+#include "workspace.h"
+
+namespace {
+    bool is_no_solution(std::exception_ptr error)
+    {
+        try
+        {
+            std::rethrow_exception(error);
+        }
+        catch(const fuzzy_vault::NoSolutionException&)
+        {
+            return true;
+        }
+        catch(...)
+        {
+        }
+        return false;
+    }
+}
+
+int main()
+{
+    kdf_params_t kdf;
+    kdf._scryptN = 16;
+    kdf._scryptP = 1;
+    const int prime = crypto::first_prime_greater_than(7776);
+    imod_t::initialize(prime);
+    const params_t params(12, 9, 7776, prime, 0, vault_version_1, kdf);
+    const std::vector<int> words = { 5, 900, 17, 3021, 44, 7000, 612, 1999, 2500, 63, 4096, 777 };
+    const secret_t secret(params, words);
+    std::vector<int> recovered;
+    std::vector<uint8_t> expected;
+    secret.recover_ek(words, recovered, expected);
+
+    // A sketch that no longer fits the words makes the decoder give up
+    // even on the original words, which the hash still accepts
+    secret_t damaged(secret);
+    for (size_t i = 0; i < damaged._sketch.size(); i++)
+        damaged._sketch[i] = (damaged._sketch[i] + 1 + static_cast<int>(i)) % prime;
+    std::vector<int> candidate;
+    decoder_workspace_t ws(12);
+    const std::exception_ptr error = damaged.get_candidate(words, candidate, ws);
+    CHECK(is_no_solution(error));
+    std::vector<int> sorted(words);
+    std::sort(sorted.begin(), sorted.end());
+    CHECK(candidate == sorted);
+
+    std::vector<uint8_t> ek;
+    bool recovered_ek = true;
+    try
+    {
+        damaged.recover_ek(words, recovered, ek);
+    }
+    catch(...)
+    {
+        recovered_ek = false;
+    }
+    CHECK(recovered_ek);
+    CHECK(ek == expected);
+
+    // other words are still refused with the decoder's exception
+    std::vector<int> wrong(words);
+    wrong[0] = 6;
+    bool refused = false;
+    try
+    {
+        damaged.recover_ek(wrong, recovered, ek);
+    }
+    catch(const fuzzy_vault::NoSolutionException&)
+    {
+        refused = true;
+    }
+    CHECK(refused);
+    CHECK(recovered.empty());
+    imod_t::cleanup();
+    return check_result();
+}
@@ -0,0 +1,91 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+/**
+ * The id of parameters depends on their values only, and compact
+ * secrets are written and read only while their parameters are
+ * registered.
+ **/
+
+#include <string>
+#include "check.h"
+#include "fuzzy.h"
+
+namespace {
+    const std::string words = "[11, 22, 33, 44, 55, 66, 77, 88, 99, 111, 222, 333]";
+
+    /// The JSON with its keys on one line, in another order and spacing
+    std::string reformatted(const std::string& json)
+    {
+        std::string out;
+        for (char c : json)
+            if (c != '\n' && c != ' ')
+                out += c;
+        const std::string key = "\"setSize\":";
+        const size_t at = out.find(key);
+        const size_t end = out.find(',', at);
+        if (at == std::string::npos || end == std::string::npos)
+            return out;
+        const std::string field = out.substr(at, end - at + 1);
+        out.erase(at, field.size());
+        return "{ " + field + " " + out.substr(1);
+    }
+
+    bool throws(const std::string& secret)
+    {
+        try
+        {
+            fuzzy_vault::compact_secret(secret);
+        }
+        catch(const std::exception&)
+        {
+            return true;
+        }
+        return false;
+    }
+}
+
+int main()
+{
+    const std::string params = fuzzy_vault::gen_params(
+        "{ \"setSize\": 12, \"correctThreshold\": 9, \"corpusSize\": 7776,"
+        "  \"scryptN\": 16, \"scryptP\": 1 }");
+    const std::string secret = fuzzy_vault::gen_secret(params, words);
+    const std::string keys = fuzzy_vault::gen_keys(secret, words, 2);
+
+    // nothing is registered behind the caller's back
+    CHECK(throws(secret));
+
+    const std::string id = fuzzy_vault::register_params(params);
+    CHECK(id.size() == 64);
+    CHECK(reformatted(params) != params);
+    CHECK(fuzzy_vault::register_params(reformatted(params)) == id);
+
+    const std::string compact = fuzzy_vault::compact_secret(secret);
+    CHECK(compact.find(id) != std::string::npos);
+    CHECK(compact.size() < secret.size());
+    CHECK(fuzzy_vault::gen_keys(compact, words, 2) == keys);
+    CHECK(fuzzy_vault::expand_secret(compact) == secret);
+
+    // as in a process that has not registered the parameters yet
+    CHECK(fuzzy_vault::unregister_params(id));
+    bool unreadable = false;
+    try
+    {
+        fuzzy_vault::gen_keys(compact, words, 2);
+    }
+    catch(const std::exception&)
+    {
+        unreadable = true;
+    }
+    CHECK(unreadable);
+    CHECK(throws(secret));
+    return check_result();
+}
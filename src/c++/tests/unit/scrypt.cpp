@@ -0,0 +1,109 @@
+/*
+* Copyright 2021 The Decentralized Identity Foundation
+* Project Authors. All Rights Reserved.
+*
+* Licensed under the Apache License 2.0 (the "License"). You may not use
+* this file except in compliance with the License. You can obtain a copy
+* in the file LICENSE in the source distribution or at
+* https://identity.foundation/
+*/
+
+/**
+ * The library's own scrypt against the test vectors of RFC 7914 and
+ * against OpenSSL on random inputs and costs, with and without workers.
+ **/
+
+#include <random>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "crypto.h"
+#include "pool.h"
+#include "scrypt.h"
+#include "types.h"
+
+namespace {
+    std::vector<uint8_t> bytes(const std::string& text)
+    {
+        return std::vector<uint8_t>(text.begin(), text.end());
+    }
+
+    std::vector<uint8_t> from_hex(const std::string& hex)
+    {
+        std::vector<uint8_t> out;
+        for (size_t i = 0; i + 1 < hex.size(); i += 2)
+            out.push_back(static_cast<uint8_t>(std::stoi(hex.substr(i, 2), 0, 16)));
+        return out;
+    }
+
+    std::vector<uint8_t> native(const std::vector<uint8_t>& pass,
+                                const std::vector<uint8_t>& salt,
+                                const kdf_params_t& kdf,
+                                size_t length
+                                )
+    {
+        std::vector<uint8_t> out(length);
+        crypto::scrypt_native(pass.data(), pass.size(), salt.data(), salt.size(), kdf, out.data(), length);
+        return out;
+    }
+
+    /// RFC 7914 section 12
+    void test_known_answers()
+    {
+        kdf_params_t kdf;
+        kdf._scryptN = 16;
+        kdf._scryptR = 1;
+        kdf._scryptP = 1;
+        CHECK(native(bytes(""), bytes(""), kdf, 64) == from_hex(
+            "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442"
+            "fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906"));
+
+        kdf._scryptN = 1024;
+        kdf._scryptR = 8;
+        kdf._scryptP = 16;
+        CHECK(native(bytes("password"), bytes("NaCl"), kdf, 64) == from_hex(
+            "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b373162"
+            "2eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640"));
+
+        kdf._scryptN = 16384;
+        kdf._scryptP = 1;
+        CHECK(native(bytes("pleaseletmein"), bytes("SodiumChloride"), kdf, 64) == from_hex(
+            "7023bdcb3afd7348461c06cd81fd38ebfda8fbba904f8e3ea9b543f6545da1f2"
+            "d5432955613f0fcf62d49705242a9af9e61e85dc0d651e40dfcf017b45575887"));
+        CHECK(crypto::scrypt_native_verified());
+    }
+
+    void test_against_openssl(std::mt19937& rng)
+    {
+        for (int run = 0; run < 40; run++)
+        {
+            kdf_params_t kdf;
+            kdf._scryptN = 2 << (rng() % 10);
+            kdf._scryptR = 1 + rng() % 8;
+            kdf._scryptP = 1 + rng() % 6;
+            std::vector<uint8_t> pass(rng() % 80);
+            std::vector<uint8_t> salt(rng() % 48);
+            for (uint8_t& b : pass)
+                b = static_cast<uint8_t>(rng());
+            for (uint8_t& b : salt)
+                b = static_cast<uint8_t>(rng());
+            const size_t length = 1 + rng() % 200;
+            std::vector<uint8_t> expected;
+            crypto::scrypt_openssl(pass, salt, expected, length, kdf);
+            CHECK(native(pass, salt, kdf, length) == expected);
+        }
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(7914);
+    thread_pool_t::instance().set_thread_count(0);
+    test_known_answers();
+    test_against_openssl(rng);
+    // the lanes spread over workers give the same bytes
+    thread_pool_t::instance().set_thread_count(3);
+    test_known_answers();
+    test_against_openssl(rng);
+    return check_result();
+}